@@ -0,0 +1,235 @@
+/*
+  ==============================================================================
+    The whole filter chain as one cascade of second order sections: the low
+    cut sections, the peak, the high cut sections and then whichever extra
+    bands are switched on. Coefficients and state are kept as one aligned
+    array per field, only the active sections are laid out, and they all run
+    in a single pass over the samples. Every section count has its own fully
+    unrolled loop, with the coefficients and state held in locals.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include <utility>
+#include "BiquadDesign.h"
+
+namespace CascadeHelpers
+{
+    // fills every lane of SampleType with the same value
+    template <typename SampleType>
+    struct Broadcast
+    {
+        static SampleType from(double value) noexcept { return static_cast<SampleType>(value); }
+    };
+
+    template <typename ElementType>
+    struct Broadcast<juce::dsp::SIMDRegister<ElementType>>
+    {
+        static juce::dsp::SIMDRegister<ElementType> from(double value) noexcept
+        {
+            return juce::dsp::SIMDRegister<ElementType>::expand(static_cast<ElementType>(value));
+        }
+    };
+
+    // per lane access and lane-wise max, so the same code handles plain samples and registers
+    template <typename SampleType>
+    struct Lanes
+    {
+        static constexpr size_t size = 1;
+        static double get(const SampleType& value, size_t) noexcept { return static_cast<double>(value); }
+        static void set(SampleType& value, size_t, double newValue) noexcept { value = static_cast<SampleType>(newValue); }
+        static SampleType max(SampleType a, SampleType b) noexcept { return juce::jmax(a, b); }
+    };
+
+    template <typename ElementType>
+    struct Lanes<juce::dsp::SIMDRegister<ElementType>>
+    {
+        using Register = juce::dsp::SIMDRegister<ElementType>;
+
+        static constexpr size_t size = Register::size();
+        static double get(const Register& value, size_t lane) noexcept { return static_cast<double>(value.get(lane)); }
+        static void set(Register& value, size_t lane, double newValue) noexcept { value.set(lane, static_cast<ElementType>(newValue)); }
+        static Register max(Register a, Register b) noexcept { return Register::max(a, b); }
+    };
+}
+
+// SampleType can be float, double or a SIMDRegister holding one sample per channel
+template <typename SampleType>
+class BiquadCascade
+{
+public:
+    // 4 low cut sections + the peak + 4 high cut sections + the extra bands
+    static constexpr int maxSections = 9 + maxBands;
+
+    BiquadCascade() { reset(); }
+
+    void reset()
+    {
+        s1.fill(broadcast(0));
+        s2.fill(broadcast(0));
+    }
+
+    // lays the active sections out as low cut, peak, high cut, bands, leaving out anything flat. Every section is tagged
+    // with what it is, so when the layout changes (a slope moves, a band is switched on or off)
+    // the state of the sections that are still there moves with them and nothing that was
+    // already running loses its history.
+    void setCoefficients(const ChainCoefficients& chain)
+    {
+        std::array<int, maxSections> newTags{};
+        int numNew = 0;
+
+        for (int i = 0; i < chain.numLowCut; ++i)
+            newTags[static_cast<size_t>(numNew++)] = lowCutTag + i;
+
+        // in dynamic mode the peak runs as a separate SVF, so it's left out here like a flat one
+        auto runPeak = chain.peakActive && !chain.dynamic.enabled;
+
+        if (runPeak)
+            newTags[static_cast<size_t>(numNew++)] = peakTag;
+
+        for (int i = 0; i < chain.numHighCut; ++i)
+            newTags[static_cast<size_t>(numNew++)] = highCutTag + i;
+
+        for (int i = 0; i < chain.numBands; ++i)
+            newTags[static_cast<size_t>(numNew++)] = bandTag + chain.bandIndex[static_cast<size_t>(i)];
+
+        if (numNew != numActive || !std::equal(newTags.begin(), newTags.begin() + numNew, tags.begin()))
+            rearrangeState(newTags, numNew);
+
+        int index = 0;
+
+        for (int i = 0; i < chain.numLowCut; ++i)
+            setSection(index++, chain.lowCut[static_cast<size_t>(i)]);
+
+        if (runPeak)
+            setSection(index++, chain.peak);
+
+        for (int i = 0; i < chain.numHighCut; ++i)
+            setSection(index++, chain.highCut[static_cast<size_t>(i)]);
+
+        for (int i = 0; i < chain.numBands; ++i)
+            setSection(index++, chain.bands[static_cast<size_t>(i)]);
+
+        numActive = index;
+    }
+
+    int getNumActiveSections() const noexcept { return numActive; }
+
+    // transposed direct form II, the same as IIR::Filter, but every active section is applied
+    // to a sample before moving on so the buffer is only read and written once
+    void process(SampleType* samples, size_t numSamples) noexcept
+    {
+        using ProcessFunction = void (BiquadCascade::*)(SampleType*, size_t) noexcept;
+
+        // every possible section count gets its own unrolled loop, so both cuts at full slope plus
+        // any number of bands still take it. Past a dozen or so sections the locals don't all fit
+        // in registers, but the spills go to the stack, which the compiler knows doesn't alias
+        // the samples, and the loop stays free of the per-section branch and index arithmetic.
+        static constexpr auto unrolled = makeUnrolledTable<ProcessFunction>(std::make_index_sequence<maxSections + 1>());
+
+        (this->*unrolled[static_cast<size_t>(numActive)])(samples, numSamples);
+    }
+
+private:
+    // what a section is, so its state can follow it around when the layout changes
+    enum
+    {
+        lowCutTag = 0,
+        peakTag = 4,
+        highCutTag = 5,
+        bandTag = 9
+    };
+
+    static SampleType broadcast(double value) noexcept
+    {
+        return CascadeHelpers::Broadcast<SampleType>::from(value);
+    }
+
+    template <typename ProcessFunction, size_t... Counts>
+    static constexpr std::array<ProcessFunction, sizeof...(Counts)> makeUnrolledTable(std::index_sequence<Counts...>) noexcept
+    {
+        return { { &BiquadCascade::processUnrolled<Counts>... } };
+    }
+
+    template <size_t NumSections>
+    void processUnrolled(SampleType* samples, size_t numSamples) noexcept
+    {
+        processUnrolled(samples, numSamples, std::make_index_sequence<NumSections>());
+    }
+
+    // the coefficients and state are copied into locals first. The compiler can't tell they
+    // don't alias the samples while they're members, and as locals they can stay in registers.
+    template <size_t... Sections>
+    void processUnrolled(SampleType* samples, size_t numSamples, std::index_sequence<Sections...>) noexcept
+    {
+        constexpr size_t num = sizeof...(Sections);
+
+        const std::array<SampleType, num> cb0{ { b0[Sections]... } }, cb1{ { b1[Sections]... } }, cb2{ { b2[Sections]... } },
+                                          ca1{ { a1[Sections]... } }, ca2{ { a2[Sections]... } };
+        std::array<SampleType, num> z1{ { s1[Sections]... } }, z2{ { s2[Sections]... } };
+
+        auto tick = [&](auto section, SampleType x) noexcept
+        {
+            constexpr size_t j = decltype(section)::value;
+
+            auto y = (cb0[j] * x) + z1[j];
+            z1[j] = (cb1[j] * x) - (ca1[j] * y) + z2[j];
+            z2[j] = (cb2[j] * x) - (ca2[j] * y);
+            return y;
+        };
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            auto x = samples[i];
+            ((x = tick(std::integral_constant<size_t, Sections>(), x)), ...);
+            samples[i] = x;
+        }
+
+        ((s1[Sections] = z1[Sections]), ...);
+        ((s2[Sections] = z2[Sections]), ...);
+        juce::ignoreUnused(tick);
+    }
+
+    void setSection(int index, const BiquadCoefficients& c) noexcept
+    {
+        auto i = static_cast<size_t>(index);
+
+        b0[i] = broadcast(c.b0);
+        b1[i] = broadcast(c.b1);
+        b2[i] = broadcast(c.b2);
+        a1[i] = broadcast(c.a1);
+        a2[i] = broadcast(c.a2);
+    }
+
+    // only runs when the layout changes, so a search per section is fine
+    void rearrangeState(const std::array<int, maxSections>& newTags, int numNew) noexcept
+    {
+        auto oldS1 = s1, oldS2 = s2;
+
+        for (size_t i = 0; i < static_cast<size_t>(numNew); ++i)
+        {
+            s1[i] = s2[i] = broadcast(0);
+
+            for (size_t j = 0; j < static_cast<size_t>(numActive); ++j)
+            {
+                if (tags[j] == newTags[i])
+                {
+                    s1[i] = oldS1[j];
+                    s2[i] = oldS2[j];
+                    break;
+                }
+            }
+        }
+
+        tags = newTags;
+        numActive = numNew;
+    }
+
+    using Field = std::array<SampleType, maxSections>;
+
+    alignas(64) Field b0, b1, b2, a1, a2;
+    alignas(64) Field s1, s2;
+    std::array<int, maxSections> tags{};
+    int numActive{ 0 };
+};
@@ -0,0 +1,276 @@
+/*
+  ==============================================================================
+    Closed-form biquad designs for the peak and the Butterworth cut filters.
+    These use the same maths as IIR::Coefficients and FilterDesign, but write
+    into plain structs so they can run on the audio thread without allocating.
+  ==============================================================================
+*/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "ChainSettings.h"
+
+// plain biquad coefficients, already normalised by a0 (same layout as IIR::Coefficients).
+// Kept in double so the double precision path gets them exactly, a 20 Hz cut at 384 kHz has
+// poles too close to 1 for float to place them properly.
+struct BiquadCoefficients
+{
+    double b0{ 1.0 }, b1{ 0.0 }, b2{ 0.0 }, a1{ 0.0 }, a2{ 0.0 };
+};
+
+// the cuts go up to 48 dB/Oct, which is four biquads
+using CutSections = std::array<BiquadCoefficients, 4>;
+
+// the peak in dynamic mode. It runs as a TPT state variable filter instead of a biquad, because
+// its gain has to move all the time and an SVF stays well behaved while it's modulated.
+struct DynamicPeakCoefficients
+{
+    bool enabled{ false }, sidechain{ false };
+    float g{ 0.f }, inverseQ{ 1.f }, maxGainDb{ 0.f }; // tan(pi f / fs), 1 / Q, the gain at full depth
+    float thresholdDb{ 0.f }, slope{ 0.f };            // slope is 1 - 1 / ratio
+    float attack{ 1.f }, release{ 1.f };               // one pole coefficients, per sample
+};
+
+// every coefficient the chain needs, stored by value so it can be copied without touching the heap
+struct ChainCoefficients
+{
+    CutSections lowCut, highCut;
+    BiquadCoefficients peak;
+    DynamicPeakCoefficients dynamic;
+    int numLowCut{ 0 }, numHighCut{ 0 };
+    bool peakActive{ false }; // false when the peak is flat and left out of the cascade
+
+    // only the bands that are switched on, packed in order, each with the band it came from
+    std::array<BiquadCoefficients, maxBands> bands;
+    std::array<int, maxBands> bandIndex{};
+    int numBands{ 0 };
+    double sampleRate{ 0 };
+    unsigned int version{ 0 }; // the parameter version it was designed for, 0 if it wasn't
+};
+
+namespace BiquadDesign
+{
+    constexpr double pi = 3.141592653589793238;
+
+    inline BiquadCoefficients normalise(double b0, double b1, double b2, double a0, double a1, double a2)
+    {
+        auto a0Inv = 1.0 / a0;
+
+        return { b0 * a0Inv, b1 * a0Inv, b2 * a0Inv, a1 * a0Inv, a2 * a0Inv };
+    }
+
+    // same as IIR::Coefficients<float>::makePeakFilter
+    inline BiquadCoefficients makePeak(double sampleRate, float frequency, float Q, float gainFactor)
+    {
+        auto A = std::sqrt(std::max(0.0, static_cast<double>(gainFactor)));
+        auto omega = (2.0 * pi * frequency) / sampleRate;
+        auto alpha = std::sin(omega) / (Q * 2.0);
+        auto c2 = -2.0 * std::cos(omega);
+        auto alphaTimesA = alpha * A;
+        auto alphaOverA = alpha / A;
+
+        return normalise(1.0 + alphaTimesA, c2, 1.0 - alphaTimesA, 1.0 + alphaOverA, c2, 1.0 - alphaOverA);
+    }
+
+    // same as IIR::Coefficients<float>::makeLowShelf
+    inline BiquadCoefficients makeLowShelf(double sampleRate, float frequency, float Q, float gainFactor)
+    {
+        auto A = std::sqrt(std::max(0.0, static_cast<double>(gainFactor)));
+        auto aMinus1 = A - 1.0, aPlus1 = A + 1.0;
+        auto omega = (2.0 * pi * frequency) / sampleRate;
+        auto cosOmega = std::cos(omega);
+        auto beta = std::sin(omega) * std::sqrt(A) / Q;
+        auto aMinus1TimesCos = aMinus1 * cosOmega;
+
+        return normalise(A * (aPlus1 - aMinus1TimesCos + beta), A * 2.0 * (aMinus1 - aPlus1 * cosOmega), A * (aPlus1 - aMinus1TimesCos - beta),
+                         aPlus1 + aMinus1TimesCos + beta, -2.0 * (aMinus1 + aPlus1 * cosOmega), aPlus1 + aMinus1TimesCos - beta);
+    }
+
+    // same as IIR::Coefficients<float>::makeHighShelf
+    inline BiquadCoefficients makeHighShelf(double sampleRate, float frequency, float Q, float gainFactor)
+    {
+        auto A = std::sqrt(std::max(0.0, static_cast<double>(gainFactor)));
+        auto aMinus1 = A - 1.0, aPlus1 = A + 1.0;
+        auto omega = (2.0 * pi * frequency) / sampleRate;
+        auto cosOmega = std::cos(omega);
+        auto beta = std::sin(omega) * std::sqrt(A) / Q;
+        auto aMinus1TimesCos = aMinus1 * cosOmega;
+
+        return normalise(A * (aPlus1 + aMinus1TimesCos + beta), A * -2.0 * (aMinus1 + aPlus1 * cosOmega), A * (aPlus1 + aMinus1TimesCos - beta),
+                         aPlus1 - aMinus1TimesCos + beta, 2.0 * (aMinus1 - aPlus1 * cosOmega), aPlus1 - aMinus1TimesCos - beta);
+    }
+
+    // same as IIR::Coefficients<float>::makeNotch and makeBandPass, which share their poles
+    inline BiquadCoefficients makeNotch(double sampleRate, float frequency, float Q)
+    {
+        auto n = 1.0 / std::tan(pi * frequency / sampleRate);
+        auto nSquared = n * n;
+        auto c1 = 1.0 / (1.0 + n / Q + nSquared);
+
+        return normalise(c1 * (1.0 + nSquared), 2.0 * c1 * (1.0 - nSquared), c1 * (1.0 + nSquared),
+                         1.0, c1 * 2.0 * (1.0 - nSquared), c1 * (1.0 - n / Q + nSquared));
+    }
+
+    inline BiquadCoefficients makeBandPass(double sampleRate, float frequency, float Q)
+    {
+        auto n = 1.0 / std::tan(pi * frequency / sampleRate);
+        auto nSquared = n * n;
+        auto c1 = 1.0 / (1.0 + n / Q + nSquared);
+
+        return normalise(c1 * n / Q, 0.0, -c1 * n / Q,
+                         1.0, c1 * 2.0 * (1.0 - nSquared), c1 * (1.0 - n / Q + nSquared));
+    }
+
+    // 12 dB/Oct cuts with their own Q, same as IIR::Coefficients<float>::makeHighPass and makeLowPass
+    inline BiquadCoefficients makeHighPass(double sampleRate, float frequency, float Q)
+    {
+        auto n = std::tan(pi * frequency / sampleRate);
+        auto nSquared = n * n;
+        auto c1 = 1.0 / (1.0 + n / Q + nSquared);
+
+        return normalise(c1, c1 * -2.0, c1, 1.0, c1 * 2.0 * (nSquared - 1.0), c1 * (1.0 - n / Q + nSquared));
+    }
+
+    inline BiquadCoefficients makeLowPass(double sampleRate, float frequency, float Q)
+    {
+        auto n = 1.0 / std::tan(pi * frequency / sampleRate);
+        auto nSquared = n * n;
+        auto c1 = 1.0 / (1.0 + n / Q + nSquared);
+
+        return normalise(c1, c1 * 2.0, c1, 1.0, c1 * 2.0 * (1.0 - nSquared), c1 * (1.0 - n / Q + nSquared));
+    }
+
+    // one biquad per band whatever its type, so every band costs the same to run
+    inline BiquadCoefficients makeBand(double sampleRate, const BandSettings& band)
+    {
+        auto gainFactor = static_cast<float>(std::pow(10.0, band.gain / 20.0));
+
+        switch (band.type)
+        {
+            case BandPeak:      return makePeak(sampleRate, band.freq, band.quality, gainFactor);
+            case BandLowShelf:  return makeLowShelf(sampleRate, band.freq, band.quality, gainFactor);
+            case BandHighShelf: return makeHighShelf(sampleRate, band.freq, band.quality, gainFactor);
+            case BandNotch:     return makeNotch(sampleRate, band.freq, band.quality);
+            case BandBandPass:  return makeBandPass(sampleRate, band.freq, band.quality);
+            case BandLowCut:    return makeHighPass(sampleRate, band.freq, band.quality);
+            case BandHighCut:   return makeLowPass(sampleRate, band.freq, band.quality);
+            case BandOff:
+            default:            return {};
+        }
+    }
+
+    // peakGain is reached once the band is far enough over the threshold, below it the band is flat
+    inline DynamicPeakCoefficients makeDynamicPeak(double sampleRate, float frequency, float Q, float peakGainDb,
+                                                   float thresholdDb, float ratio, float attackMs, float releaseMs)
+    {
+        auto onePole = [sampleRate](float ms) { return static_cast<float>(1.0 - std::exp(-1.0 / (std::max(0.01, static_cast<double>(ms)) * 0.001 * sampleRate))); };
+
+        DynamicPeakCoefficients c;
+        c.enabled = true;
+        c.g = static_cast<float>(std::tan(pi * std::min(static_cast<double>(frequency), sampleRate * 0.49) / sampleRate));
+        c.inverseQ = 1.f / Q;
+        c.maxGainDb = peakGainDb;
+        c.thresholdDb = thresholdDb;
+        c.slope = 1.f - 1.f / std::max(1.f, ratio);
+        c.attack = onePole(attackMs);
+        c.release = onePole(releaseMs);
+        return c;
+    }
+
+    // how many samples the impulse response of a section takes to fall below threshold, going by
+    // its slowest pole. A section on the edge of stability reports maxSamples.
+    inline double decaySamples(const BiquadCoefficients& c, double threshold, double maxSamples)
+    {
+        const double a1 = c.a1, a2 = c.a2;
+        auto discriminant = a1 * a1 - 4.0 * a2;
+
+        auto radius = discriminant < 0.0 ? std::sqrt(a2)
+                                         : std::max(std::abs(-a1 + std::sqrt(discriminant)), std::abs(-a1 - std::sqrt(discriminant))) * 0.5;
+
+        if (radius >= 1.0)
+            return maxSamples;
+
+        // the FIR part alone lasts two samples
+        if (radius < 1.0e-9)
+            return 2.0;
+
+        return std::min(maxSamples, 2.0 + std::log(threshold) / std::log(radius));
+    }
+
+    // cos() for the tables below, which have to be worked out at compile time. The Taylor series
+    // is exact to double precision well past the angles they need (all under pi / 2).
+    constexpr double constexprCos(double x)
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int i = 1; i < 24; ++i)
+        {
+            term *= -x * x / ((2.0 * i - 1.0) * (2.0 * i));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    // 1 / Q of each biquad in an even order Butterworth filter, 2 cos((2k + 1) pi / 2N), in the
+    // same order as FilterDesign. The cuts only ever use orders 2, 4, 6 and 8, so those are all
+    // there is, indexed by the number of sections minus one.
+    constexpr std::array<double, 4> makeButterworthInverseQs(int order)
+    {
+        std::array<double, 4> inverseQs{};
+
+        for (int k = 0; k < order / 2; ++k)
+            inverseQs[static_cast<size_t>(k)] = 2.0 * constexprCos((2.0 * k + 1.0) * pi / (order * 2.0));
+
+        return inverseQs;
+    }
+
+    constexpr std::array<std::array<double, 4>, 4> butterworthInverseQs{ makeButterworthInverseQs(2), makeButterworthInverseQs(4),
+                                                                         makeButterworthInverseQs(6), makeButterworthInverseQs(8) };
+
+    static_assert(butterworthInverseQs[0][0] > 1.41421356237309 && butterworthInverseQs[0][0] < 1.41421356237310,
+                  "a second order Butterworth filter has a Q of 1 / sqrt(2)");
+
+    // the high and low pass share their poles once they're both written in terms of tan(pi f / fs),
+    // only the zeros differ. Per update that's one tan() and one division per section.
+    template <bool isHighPass>
+    inline int makeButterworth(double sampleRate, float frequency, int order, CutSections& sections)
+    {
+        auto numSections = std::min(order / 2, static_cast<int>(sections.size()));
+
+        if (numSections <= 0)
+            return 0;
+
+        const auto& inverseQs = butterworthInverseQs[static_cast<size_t>(numSections - 1)];
+        auto t = std::tan(pi * frequency / sampleRate);
+        auto tSquared = t * t;
+
+        for (int i = 0; i < numSections; ++i)
+        {
+            auto inverseQ = inverseQs[static_cast<size_t>(i)];
+            auto scale = 1.0 / (1.0 + inverseQ * t + tSquared);
+            auto zeros = isHighPass ? scale : tSquared * scale;
+
+            sections[static_cast<size_t>(i)] = { zeros, isHighPass ? -2.0 * zeros : 2.0 * zeros, zeros,
+                                                 2.0 * (tSquared - 1.0) * scale, (1.0 - inverseQ * t + tSquared) * scale };
+        }
+
+        return numSections;
+    }
+
+    // same response as designIIRHighpassHighOrderButterworthMethod for orders 2 to 8,
+    // returns how many sections were written
+    inline int makeButterworthHighPass(double sampleRate, float frequency, int order, CutSections& sections)
+    {
+        return makeButterworth<true>(sampleRate, frequency, order, sections);
+    }
+
+    // same response as designIIRLowpassHighOrderButterworthMethod for orders 2 to 8,
+    // returns how many sections were written
+    inline int makeButterworthLowPass(double sampleRate, float frequency, int order, CutSections& sections)
+    {
+        return makeButterworth<false>(sampleRate, frequency, order, sections);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+    The settings shared by the processor, the coefficient designer and the
+    smoother.
+  ==============================================================================
+*/
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <type_traits>
+
+const std::integral_constant<int, 0> LowCut;
+const std::integral_constant<int, 1> Peak;
+const std::integral_constant<int, 2> HighCut;
+
+enum Slope
+{
+    Slope1,
+    Slope2,
+    Slope3,
+    Slope4
+};
+
+// the extra bands on top of the low cut, peak and high cut
+constexpr int maxBands = 24;
+
+enum BandType
+{
+    BandOff,
+    BandPeak,
+    BandLowShelf,
+    BandHighShelf,
+    BandNotch,
+    BandBandPass,
+    BandLowCut,
+    BandHighCut
+};
+
+// gain is only used by the peak and the shelves
+struct BandSettings
+{
+    BandType type{ BandOff };
+    float freq{ 1000.f }, gain{ 0.f }, quality{ 0.71f };
+};
+
+
+//creating a structure so that the apvts can pull these values every time it is called, rather than having to write them out over and over.
+struct chainsettings
+{
+    float peakFreq{ 0 }, peakGain{ 0 }, peakQuality{ 1.f };
+    float lowCutFreq{ 0 }, highCutFreq{ 0 };
+    Slope lowCutSlope{ Slope::Slope1 }, highCutSlope{ Slope::Slope1 };
+
+    // dynamic mode for the peak: the band stays flat until the level in it (or in the sidechain)
+    // goes over the threshold, then moves towards peakGain by the ratio
+    bool dynamicPeak{ false }, dynamicSidechain{ false };
+    float dynamicThreshold{ -24.f }, dynamicRatio{ 2.f }, dynamicAttack{ 10.f }, dynamicRelease{ 100.f };
+
+    std::array<BandSettings, maxBands> bands;
+};
+
+// blends two settings for the morph control. Frequencies and Q move on a log scale so the
+// sweep sounds even, the gain moves linearly and the slopes switch over halfway.
+inline chainsettings interpolate(const chainsettings& from, const chainsettings& to, float amount)
+{
+    auto geometric = [amount](float a, float b) { return a * std::pow(b / a, amount); };
+
+    // the dynamic settings and the extra bands aren't part of a preset, they stay as they are
+    auto result = from;
+    result.peakFreq = geometric(from.peakFreq, to.peakFreq);
+    result.peakGain = from.peakGain + amount * (to.peakGain - from.peakGain);
+    result.peakQuality = geometric(from.peakQuality, to.peakQuality);
+    result.lowCutFreq = geometric(from.lowCutFreq, to.lowCutFreq);
+    result.highCutFreq = geometric(from.highCutFreq, to.highCutFreq);
+    result.lowCutSlope = amount < 0.5f ? from.lowCutSlope : to.lowCutSlope;
+    result.highCutSlope = amount < 0.5f ? from.highCutSlope : to.highCutSlope;
+    return result;
+}
@@ -0,0 +1,217 @@
+/*
+  ==============================================================================
+    Designs the filter coefficients on a background thread so that the audio
+    thread only has to copy finished coefficient sets into the chains.
+  ==============================================================================
+*/
+#include "CoefficientDesigner.h"
+#include "PluginProcessor.h"
+
+namespace
+{
+    // how often the shared designer thread looks at every instance's parameter version
+    constexpr int designIntervalMs = 5;
+
+    // settings that leave a stage effectively flat, those stages are left out of the cascade.
+    // The cuts never are: a Butterworth cut is 3 dB down at its cutoff, and the cutoffs can't
+    // leave 20 Hz to 20 kHz, so they always run.
+    constexpr float neutralGainDb = 0.01f;
+
+    bool isNeutral(const BandSettings& band)
+    {
+        switch (band.type)
+        {
+            case BandOff:
+                return true;
+
+            case BandPeak:
+            case BandLowShelf:
+            case BandHighShelf:
+                return std::abs(band.gain) < neutralGainDb;
+
+            default:
+                return false;
+        }
+    }
+
+    // -100 dB, the same level the processor treats as silence
+    constexpr double tailThreshold = 1.0e-5;
+    constexpr double maxTailSeconds = 10.0;
+}
+
+ChainCoefficients makeChainCoefficients(const chainsettings& settings, double sampleRate, bool keepFlatStages)
+{
+    ChainCoefficients chain;
+    chain.sampleRate = sampleRate;
+
+    // a flat peak stays at unity and isn't run
+    chain.peakActive = keepFlatStages || std::abs(settings.peakGain) >= neutralGainDb;
+
+    if (chain.peakActive)
+        chain.peak = BiquadDesign::makePeak(sampleRate, settings.peakFreq, settings.peakQuality, juce::Decibels::decibelsToGain(settings.peakGain));
+
+    // every 2 orders is one biquad, so slope x needs (x + 1) * 2 orders
+    chain.numLowCut = BiquadDesign::makeButterworthHighPass(sampleRate, settings.lowCutFreq, (settings.lowCutSlope + 1) * 2, chain.lowCut);
+    chain.numHighCut = BiquadDesign::makeButterworthLowPass(sampleRate, settings.highCutFreq, (settings.highCutSlope + 1) * 2, chain.highCut);
+
+    // bands that are off (or flat, outside a ramp) aren't designed and never reach the cascade
+    for (int i = 0; i < maxBands; ++i)
+    {
+        const auto& band = settings.bands[static_cast<size_t>(i)];
+
+        if (band.type == BandOff || (!keepFlatStages && isNeutral(band)))
+            continue;
+
+        auto slot = static_cast<size_t>(chain.numBands++);
+        chain.bands[slot] = BiquadDesign::makeBand(sampleRate, band);
+        chain.bandIndex[slot] = i;
+    }
+
+    // the static peak is still designed, the response curve and linear phase mode use it
+    if (settings.dynamicPeak && chain.peakActive)
+    {
+        chain.dynamic = BiquadDesign::makeDynamicPeak(sampleRate, settings.peakFreq, settings.peakQuality, settings.peakGain,
+                                                      settings.dynamicThreshold, settings.dynamicRatio,
+                                                      settings.dynamicAttack, settings.dynamicRelease);
+        chain.dynamic.sidechain = settings.dynamicSidechain;
+    }
+
+    return chain;
+}
+
+double getTailLengthSeconds(const ChainCoefficients& chain)
+{
+    if (chain.sampleRate <= 0)
+        return 0.0;
+
+    // the sections run in series, so adding up their decay times is on the safe side
+    auto maxSamples = maxTailSeconds * chain.sampleRate;
+    auto samples = 0.0;
+
+    auto add = [&](const BiquadCoefficients& section)
+    {
+        samples += BiquadDesign::decaySamples(section, tailThreshold, maxSamples);
+    };
+
+    for (int i = 0; i < chain.numLowCut; ++i)
+        add(chain.lowCut[static_cast<size_t>(i)]);
+
+    // the dynamic peak's SVF rings like the static peak at full depth
+    if (chain.peakActive)
+        add(chain.peak);
+
+    for (int i = 0; i < chain.numHighCut; ++i)
+        add(chain.highCut[static_cast<size_t>(i)]);
+
+    for (int i = 0; i < chain.numBands; ++i)
+        add(chain.bands[static_cast<size_t>(i)]);
+
+    return juce::jmin(samples, maxSamples) / chain.sampleRate;
+}
+
+//==============================================================================
+CoefficientDesigner::SharedThread::SharedThread()
+    : juce::Thread("EQ coefficient designer")
+{
+}
+
+CoefficientDesigner::SharedThread::~SharedThread()
+{
+    stopThread(1000);
+}
+
+void CoefficientDesigner::SharedThread::add(CoefficientDesigner& designer)
+{
+    const juce::ScopedLock startStop(startStopLock);
+
+    {
+        const juce::ScopedLock sl(lock);
+        designers.addIfNotAlreadyThere(&designer);
+    }
+
+    startThread();
+}
+
+void CoefficientDesigner::SharedThread::remove(CoefficientDesigner& designer)
+{
+    const juce::ScopedLock startStop(startStopLock);
+    bool empty;
+
+    {
+        const juce::ScopedLock sl(lock);
+        designers.removeFirstMatchingValue(&designer);
+        empty = designers.isEmpty();
+    }
+
+    // nobody left to design for, so there's no need to keep waking up
+    if (empty)
+        stopThread(1000);
+}
+
+void CoefficientDesigner::SharedThread::run()
+{
+    while (!threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl(lock);
+
+            for (auto* designer : designers)
+                designer->designIfChanged();
+        }
+
+        wait(designIntervalMs);
+    }
+}
+
+//==============================================================================
+CoefficientDesigner::CoefficientDesigner(std::function<chainsettings()> getSettingsToUse, const std::atomic<juce::uint32>& version)
+    : getSettings(std::move(getSettingsToUse)), parameterVersion(version)
+{
+}
+
+CoefficientDesigner::~CoefficientDesigner()
+{
+    release();
+}
+
+void CoefficientDesigner::prepare(double newSampleRate)
+{
+    // the exchange only allows one writer, so the shared thread has to let go of us while we design here
+    release();
+
+    sampleRate = newSampleRate;
+    designAndPublish(parameterVersion.load());
+
+    sharedThread->add(*this);
+    registered = true;
+}
+
+void CoefficientDesigner::release()
+{
+    if (registered)
+        sharedThread->remove(*this);
+
+    registered = false;
+}
+
+void CoefficientDesigner::designIfChanged()
+{
+    auto version = parameterVersion.load();
+
+    if (version != lastDesignedVersion)
+        designAndPublish(version);
+}
+
+void CoefficientDesigner::designAndPublish(juce::uint32 version)
+{
+    lastDesignedVersion = version;
+
+    auto coefficients = makeChainCoefficients(getSettings(), sampleRate.load());
+    coefficients.version = version;
+    tailLengthSeconds = ::getTailLengthSeconds(coefficients);
+    exchange.publish(coefficients);
+    ++numDesigns;
+
+    if (onDesigned != nullptr)
+        onDesigned(coefficients);
+}
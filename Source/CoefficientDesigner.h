@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+    Designs the filter coefficients on a background thread so that the audio
+    thread only has to copy finished coefficient sets into the chains.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChainSettings.h"
+#include "BiquadDesign.h"
+#include "LatestValueExchange.h"
+
+// doesn't allocate, so this is safe to call from the audio thread as well. A flat peak or band
+// is left out unless keepFlatStages is set, which the smoother uses so nothing drops out mid-ramp.
+ChainCoefficients makeChainCoefficients(const chainsettings& settings, double sampleRate, bool keepFlatStages = false);
+
+// how long the active sections keep ringing after the input stops, until they're below -100 dB
+double getTailLengthSeconds(const ChainCoefficients& chain);
+
+// every instance's designer is looked after by one shared thread, so a session full of
+// instances costs one wakeup per interval rather than one per instance
+class CoefficientDesigner
+{
+public:
+    // the designer calls getSettings whenever the parameter version moves on
+    CoefficientDesigner(std::function<chainsettings()> getSettings, const std::atomic<juce::uint32>& parameterVersion);
+    ~CoefficientDesigner();
+
+    // designs one set straight away (so the first block is correct) and hands the
+    // designer to the shared thread
+    void prepare(double sampleRate);
+
+    // takes the designer off the shared thread, once this returns it isn't designing anything
+    void release();
+
+    // changes the rate future designs are made for (oversampling changes it), call it before
+    // bumping the parameter version so the redesign uses the new rate
+    void setSampleRate(double newSampleRate) { sampleRate = newSampleRate; }
+    double getSampleRate() const noexcept { return sampleRate.load(); }
+
+    // audio thread: returns the newest coefficients, or nullptr if nothing changed
+    const ChainCoefficients* pullLatest() { return exchange.pull(); }
+
+    // the tail of the newest set, see getTailLengthSeconds(const ChainCoefficients&)
+    double getTailLengthSeconds() const noexcept { return tailLengthSeconds.load(); }
+
+    // how many sets have been designed so far, for the tools to check nothing is designed twice
+    int getNumDesigns() const noexcept { return numDesigns.load(); }
+
+    // called on the designer thread (or from prepare) with every new set, for work that
+    // depends on the coefficients and is too slow for the audio thread
+    std::function<void(const ChainCoefficients&)> onDesigned;
+
+private:
+    // walks every registered designer and redesigns the ones whose version has moved on.
+    // It polls instead of being woken up so the audio thread never has to signal it.
+    class SharedThread : private juce::Thread
+    {
+    public:
+        SharedThread();
+        ~SharedThread() override;
+
+        void add(CoefficientDesigner& designer);
+        void remove(CoefficientDesigner& designer);
+
+    private:
+        void run() override;
+
+        // held for a whole pass, so remove() can't return while the designer is in use
+        juce::CriticalSection lock;
+
+        // keeps an add and a remove from two instances from stopping the thread under the one that's just been added
+        juce::CriticalSection startStopLock;
+        juce::Array<CoefficientDesigner*> designers;
+    };
+
+    void designIfChanged();
+    void designAndPublish(juce::uint32 version);
+
+    std::function<chainsettings()> getSettings;
+    const std::atomic<juce::uint32>& parameterVersion;
+    juce::uint32 lastDesignedVersion{ 0 };
+    std::atomic<double> sampleRate{ 44100.0 };
+    std::atomic<double> tailLengthSeconds{ 0.0 };
+    std::atomic<int> numDesigns{ 0 };
+    bool registered{ false };
+
+    LatestValueExchange<ChainCoefficients> exchange;
+    juce::SharedResourcePointer<SharedThread> sharedThread;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CoefficientDesigner)
+};
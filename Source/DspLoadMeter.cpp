@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+    Measures how long each stage of processBlock takes. The audio thread pushes
+    one timing record per block into a lock-free FIFO, and a timer of the
+    meter's own drains it into running statistics on the message thread.
+    Anything that asks only gets a copy of those, so the editor and any
+    monitoring can read them side by side without taking records from each other.
+  ==============================================================================
+*/
+#include "DspLoadMeter.h"
+
+namespace
+{
+    // roughly the last second of blocks at typical buffer sizes
+    constexpr double averagingCoefficient = 0.02;
+
+    // often enough that the FIFO never fills, even with 32 sample blocks at 192 kHz
+    constexpr int drainIntervalHz = 20;
+}
+
+DspLoadMeter::DspLoadMeter()
+    : ticksPerSecond(static_cast<double>(juce::Time::getHighResolutionTicksPerSecond()))
+{
+    startTimerHz(drainIntervalHz);
+}
+
+DspLoadMeter::~DspLoadMeter()
+{
+    stopTimer();
+}
+
+void DspLoadMeter::timerCallback()
+{
+    const juce::ScopedLock lock(statisticsLock);
+    drain();
+}
+
+void DspLoadMeter::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    resetStatistics();
+}
+
+void DspLoadMeter::beginBlock(int numSamples) noexcept
+{
+    pending = {};
+    pending.numSamples = numSamples;
+    blockStart = now();
+}
+
+void DspLoadMeter::endBlock() noexcept
+{
+    pending.totalTicks = now() - blockStart;
+
+    // if nobody is reading the FIFO fills up and the record is simply dropped
+    const auto write = fifo.write(1);
+
+    if (write.blockSize1 > 0)
+        records[static_cast<size_t>(write.startIndex1)] = pending;
+}
+
+void DspLoadMeter::drain()
+{
+    const auto read = fifo.read(fifo.getNumReady());
+
+    auto addRecord = [this](const BlockRecord& record)
+    {
+        if (record.numSamples <= 0)
+            return;
+
+        auto budget = record.numSamples / sampleRate.load();
+        auto toPercent = [&](juce::int64 ticks) { return 100.0 * (ticks / ticksPerSecond) / budget; };
+
+        auto load = toPercent(record.totalTicks);
+        auto first = statistics.numBlocks++ == 0;
+
+        statistics.current = load;
+        statistics.worst = juce::jmax(statistics.worst, load);
+
+        windowWorst = juce::jmax(windowWorst, load);
+        windowSamples += record.numSamples;
+        statistics.recentWorst = juce::jmax(windowWorst, previousWindowWorst);
+
+        if (windowSamples >= static_cast<juce::int64>(sampleRate.load()))
+        {
+            previousWindowWorst = windowWorst;
+            windowWorst = 0;
+            windowSamples = 0;
+        }
+        statistics.average = first ? load : statistics.average + averagingCoefficient * (load - statistics.average);
+
+        for (int stage = 0; stage < numStages; ++stage)
+        {
+            auto stageLoad = toPercent(record.stageTicks[static_cast<size_t>(stage)]);
+            auto& average = statistics.stageAverage[static_cast<size_t>(stage)];
+            average = first ? stageLoad : average + averagingCoefficient * (stageLoad - average);
+        }
+    };
+
+    for (int i = 0; i < read.blockSize1; ++i)
+        addRecord(records[static_cast<size_t>(read.startIndex1 + i)]);
+
+    for (int i = 0; i < read.blockSize2; ++i)
+        addRecord(records[static_cast<size_t>(read.startIndex2 + i)]);
+}
+
+DspLoadMeter::Statistics DspLoadMeter::getStatistics()
+{
+    const juce::ScopedLock lock(statisticsLock);
+    return statistics;
+}
+
+void DspLoadMeter::resetStatistics()
+{
+    const juce::ScopedLock lock(statisticsLock);
+    drain();
+    statistics = {};
+    windowWorst = previousWindowWorst = 0;
+    windowSamples = 0;
+}
@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+    Measures how long each stage of processBlock takes. The audio thread pushes
+    one timing record per block into a lock-free FIFO, and a timer of the
+    meter's own drains it into running statistics on the message thread.
+    Anything that asks only gets a copy of those, so the editor and any
+    monitoring can read them side by side without taking records from each other.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+
+class DspLoadMeter : private juce::Timer
+{
+public:
+    enum Stage
+    {
+        coefficientUpdate,
+        cascadeStage,       // the cuts, the static peak and the bands run in one fused loop, so they're one figure
+        dynamicStage,       // the peak band in dynamic mode, timed on its own inside the engine
+        convolutionStage,   // linear phase mode, instead of the IIR stages
+        numStages
+    };
+
+    // all values are a percentage of the real-time budget (the length of the block in seconds).
+    // worst is the worst block since the last reset, recentWorst only looks back over the last
+    // second or two of audio, so one bad block doesn't stick on the display for good.
+    struct Statistics
+    {
+        double current{ 0 }, average{ 0 }, worst{ 0 }, recentWorst{ 0 };
+        std::array<double, numStages> stageAverage{};
+        juce::int64 numBlocks{ 0 };
+    };
+
+    // on the message thread, which the draining timer runs on
+    DspLoadMeter();
+    ~DspLoadMeter() override;
+
+    void prepare(double sampleRate);
+
+    //==============================================================================
+    // audio thread only
+    static juce::int64 now() noexcept { return juce::Time::getHighResolutionTicks(); }
+
+    void beginBlock(int numSamples) noexcept;
+    void addStageTime(Stage stage, juce::int64 ticks) noexcept { pending.stageTicks[stage] += ticks; }
+    void endBlock() noexcept;
+
+    //==============================================================================
+    // any other thread, never the audio thread. The statistics are as of the last drain, a
+    // tenth of a second ago at most.
+    Statistics getStatistics();
+    void resetStatistics();
+
+private:
+    void timerCallback() override;
+
+    struct BlockRecord
+    {
+        std::array<juce::int64, numStages> stageTicks{};
+        juce::int64 totalTicks{ 0 };
+        int numSamples{ 0 };
+    };
+
+    void drain();
+
+    static constexpr int fifoSize = 512;
+
+    juce::AbstractFifo fifo{ fifoSize };
+    std::array<BlockRecord, fifoSize> records;
+
+    BlockRecord pending;
+    juce::int64 blockStart{ 0 };
+    std::atomic<double> sampleRate{ 44100.0 };
+
+    // only the reading side takes this, the audio thread never waits on it
+    juce::CriticalSection statisticsLock;
+    Statistics statistics;
+    double ticksPerSecond;
+
+    // recentWorst is the worse of the last full second of audio and the one still filling up
+    double windowWorst{ 0 }, previousWindowWorst{ 0 };
+    juce::int64 windowSamples{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DspLoadMeter)
+};
@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+    The peak band in dynamic mode. The bell is a TPT state variable filter
+    (Zavalishin/Simper), whose gain can move while it runs without the
+    clicks or instability a modulated biquad has. A second SVF band-passes
+    the key signal at the same frequency and a one pole follower tracks its
+    power. The gain is only worked out every controlInterval samples, and
+    the bell's coefficients are ramped linearly in between, so the cost per
+    sample stays small and constant. The intervals run on from one call to
+    the next, so the gain follows the same path whatever the block size.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadCascade.h"
+
+// SampleType can be float, double or a SIMDRegister holding one sample per channel
+template <typename SampleType>
+class DynamicBand
+{
+public:
+    static constexpr size_t controlInterval = 16;
+
+    DynamicBand() { reset(); }
+
+    void reset()
+    {
+        ic1 = ic2 = d1 = d2 = envelope = broadcast(0);
+
+        // a flat bell has k = 1 / Q and nothing mixed in
+        a1 = broadcast(1.0 / (1.0 + coefficients.g * (coefficients.g + coefficients.inverseQ)));
+        m1 = broadcast(0);
+        a1Step = m1Step = broadcast(0);
+        samplesUntilUpdate = 0;
+    }
+
+    // a band that has just been switched on starts from silence rather than from wherever it was
+    void setCoefficients(const DynamicPeakCoefficients& newCoefficients)
+    {
+        auto switchedOn = newCoefficients.enabled && !coefficients.enabled;
+        coefficients = newCoefficients;
+
+        if (switchedOn)
+            reset();
+
+        g = broadcast(coefficients.g);
+
+        // the detector is a plain band-pass at the band's frequency and Q, scaled to unity at the centre
+        auto detectorA1 = 1.0 / (1.0 + coefficients.g * (coefficients.g + coefficients.inverseQ));
+        detectorK = broadcast(coefficients.inverseQ);
+        da1 = broadcast(detectorA1);
+        da2 = broadcast(coefficients.g * detectorA1);
+        da3 = broadcast(coefficients.g * coefficients.g * detectorA1);
+
+        release = broadcast(coefficients.release);
+        attackMinusRelease = broadcast(coefficients.attack - coefficients.release);
+    }
+
+    bool isEnabled() const noexcept { return coefficients.enabled; }
+    bool usesSidechain() const noexcept { return coefficients.sidechain; }
+
+    // filters samples in place, key is what the detector listens to
+    void process(SampleType* samples, const SampleType* key, size_t numSamples) noexcept
+    {
+        const auto zero = broadcast(0), two = broadcast(2);
+
+        for (size_t start = 0; start < numSamples;)
+        {
+            if (samplesUntilUpdate == 0)
+            {
+                // the gain for the end of this interval, from the envelope at its start
+                SampleType targetA1, targetM1;
+                computeTargets(targetA1, targetM1);
+
+                const auto inverseInterval = broadcast(1.0 / static_cast<double>(controlInterval));
+                a1Step = (targetA1 - a1) * inverseInterval;
+                m1Step = (targetM1 - m1) * inverseInterval;
+                samplesUntilUpdate = controlInterval;
+            }
+
+            // an interval the last call stopped partway through is finished off first
+            auto num = juce::jmin(samplesUntilUpdate, numSamples - start);
+
+            for (size_t i = start; i < start + num; ++i)
+            {
+                // detector: band-pass the key and follow its power, faster going up than down
+                auto x = key[i];
+                auto v3 = x - d2;
+                auto v1 = (da1 * d1) + (da2 * v3);
+                auto v2 = d2 + (da2 * d1) + (da3 * v3);
+                d1 = (two * v1) - d1;
+                d2 = (two * v2) - d2;
+
+                auto band = detectorK * v1;
+                auto difference = (band * band) - envelope;
+                envelope = envelope + (release * difference) + (attackMinusRelease * Lanes::max(difference, zero));
+
+                // bell: interpolating a1 is the same as moving k, so the filter stays a proper SVF
+                a1 = a1 + a1Step;
+                m1 = m1 + m1Step;
+
+                auto a2 = g * a1;
+                auto a3 = g * a2;
+
+                auto in = samples[i];
+                v3 = in - ic2;
+                v1 = (a1 * ic1) + (a2 * v3);
+                v2 = ic2 + (a2 * ic1) + (a3 * v3);
+                ic1 = (two * v1) - ic1;
+                ic2 = (two * v2) - ic2;
+
+                samples[i] = in + (m1 * v1);
+            }
+
+            samplesUntilUpdate -= num;
+            start += num;
+        }
+    }
+
+private:
+    using Lanes = CascadeHelpers::Lanes<SampleType>;
+
+    static SampleType broadcast(double value) noexcept
+    {
+        return CascadeHelpers::Broadcast<SampleType>::from(value);
+    }
+
+    // the gain computer, once per lane per chunk. A bell with gain A has k = 1 / (Q A) and mixes
+    // in k (A^2 - 1) of the band-pass output.
+    void computeTargets(SampleType& targetA1, SampleType& targetM1) const noexcept
+    {
+        targetA1 = a1;
+        targetM1 = m1;
+
+        for (size_t lane = 0; lane < Lanes::size; ++lane)
+        {
+            auto levelDb = 10.0 * std::log10(Lanes::get(envelope, lane) + 1.0e-12);
+            auto depth = juce::jmax(0.0, levelDb - coefficients.thresholdDb) * coefficients.slope;
+            auto gainDb = coefficients.maxGainDb >= 0.f ? juce::jmin(depth, static_cast<double>(coefficients.maxGainDb))
+                                                        : juce::jmax(-depth, static_cast<double>(coefficients.maxGainDb));
+
+            auto A = std::pow(10.0, gainDb / 40.0);
+            auto k = coefficients.inverseQ / A;
+
+            Lanes::set(targetA1, lane, 1.0 / (1.0 + coefficients.g * (coefficients.g + k)));
+            Lanes::set(targetM1, lane, k * (A * A - 1.0));
+        }
+    }
+
+    DynamicPeakCoefficients coefficients;
+
+    SampleType g, detectorK, da1, da2, da3, release, attackMinusRelease;
+    SampleType ic1, ic2, d1, d2, envelope, a1, m1;
+
+    // the ramp in progress and how much of its interval is left, kept between calls
+    SampleType a1Step, m1Step;
+    size_t samplesUntilUpdate{ 0 };
+};
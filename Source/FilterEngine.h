@@ -0,0 +1,289 @@
+/*
+  ==============================================================================
+    Runs the biquad cascade over any number of channels. Channels are grouped
+    into SIMD registers (4 floats with SSE/NEON, 8 with AVX), so one pass of the
+    cascade filters a whole group at once and the cost grows with the number
+    of groups rather than the number of channels. A peak band in dynamic mode
+    runs after the cascade for each group, listening either to the group's own
+    input or to a sidechain key. On a wide bus the groups can be shared out
+    over a WorkerPool, since no two of them touch the same state, and long
+    blocks are worked through in tiles small enough to stay in L1.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadCascade.h"
+#include "DynamicBand.h"
+#include "WorkerPool.h"
+
+template <typename SampleType>
+class FilterEngine
+{
+public:
+    using Vector = juce::dsp::SIMDRegister<SampleType>;
+    static constexpr size_t lanes = Vector::size();
+
+    // below this many samples times groups the work isn't worth waking anyone for
+    static constexpr size_t minParallelGroupSamples = 4096;
+
+    // a tile's interleaved samples, its key and the channel samples they come from have to fit
+    // in here together, which is the smallest L1 data cache on anything we run on
+    static constexpr size_t l1CacheBytes = 32 * 1024;
+
+    static int getAutomaticTileSize() noexcept
+    {
+        constexpr auto bytesPerSample = 2 * sizeof(Vector) + 2 * lanes * sizeof(SampleType);
+        return static_cast<int>(juce::jmax<size_t>(64, l1CacheBytes / bytesPerSample / 64 * 64));
+    }
+
+    // allocates everything processing needs, so call this from prepareToPlay. With a pool the
+    // groups are shared out between its threads, and each of them gets its own scratch buffers.
+    // Blocks longer than tileSizeToUse samples are processed in tiles of that size, 0 picks
+    // one from the cache size (and no tiling at all when the blocks are smaller than that).
+    void prepare(int numChannelsToUse, int maximumBlockSize, WorkerPool* workerPool = nullptr, int tileSizeToUse = 0)
+    {
+        numChannels = static_cast<size_t>(juce::jmax(1, numChannelsToUse));
+        auto numGroups = (numChannels + lanes - 1) / lanes;
+        auto maxSamples = static_cast<size_t>(juce::jmax(1, maximumBlockSize));
+
+        // the scratch buffers only ever hold one tile, so they're sized for that
+        tileSize = juce::jmin(maxSamples, static_cast<size_t>(tileSizeToUse > 0 ? tileSizeToUse : getAutomaticTileSize()));
+
+        cascades.clear();
+        cascades.resize(numGroups);
+        dynamicBands.clear();
+        dynamicBands.resize(numGroups);
+
+        // a single group has nothing to share
+        pool = numGroups > 1 && workerPool != nullptr && workerPool->getNumWorkers() > 0 ? workerPool : nullptr;
+
+        scratch.clear();
+        scratch.resize(pool != nullptr ? static_cast<size_t>(pool->getNumParticipants()) : 1);
+
+        for (auto& buffers : scratch)
+        {
+            buffers.interleaved = juce::dsp::AudioBlock<Vector>(buffers.interleavedData, 1, tileSize);
+            buffers.keyInterleaved = juce::dsp::AudioBlock<Vector>(buffers.keyData, 1, tileSize);
+            buffers.discard = juce::dsp::AudioBlock<SampleType>(buffers.discardData, 1, tileSize);
+
+            buffers.inputPointers.calloc(lanes);
+            buffers.outputPointers.calloc(lanes);
+            buffers.keyPointers.calloc(lanes);
+        }
+
+        zero = juce::dsp::AudioBlock<SampleType>(zeroData, 1, tileSize);
+        zero.clear();
+    }
+
+    void reset()
+    {
+        for (auto& cascade : cascades)
+            cascade.reset();
+
+        for (auto& band : dynamicBands)
+            band.reset();
+    }
+
+    void setCoefficients(const ChainCoefficients& coefficients)
+    {
+        for (auto& cascade : cascades)
+            cascade.setCoefficients(coefficients);
+
+        for (auto& band : dynamicBands)
+            band.setCoefficients(coefficients.dynamic);
+    }
+
+    int getNumChannels() const noexcept { return static_cast<int>(numChannels); }
+
+    // audio thread, after process: adds the ticks the groups spent in the dynamic band, and in
+    // the whole of processGroup, since the last call. Groups that ran on the workers count
+    // too, so this is CPU time summed over the threads, for working out the dynamic band's share.
+    void takeGroupTicks(juce::int64& dynamicTicks, juce::int64& totalTicks) noexcept
+    {
+        for (auto& buffers : scratch)
+        {
+            dynamicTicks += std::exchange(buffers.dynamicTicks, 0);
+            totalTicks += std::exchange(buffers.groupTicks, 0);
+        }
+    }
+
+    // every group has the same coefficients, so the first one speaks for all of them
+    bool isBypassed() const noexcept
+    {
+        return cascades.empty() || (cascades.front().getNumActiveSections() == 0 && !dynamicBands.front().isEnabled());
+    }
+
+    // key is the sidechain, only used by a dynamic peak that's set to listen to it. It must be
+    // as long as the block; channels are matched up, with a mono key feeding every channel.
+    void process(juce::dsp::AudioBlock<SampleType>& block, const juce::dsp::AudioBlock<SampleType>* key = nullptr)
+    {
+        // with every stage at a neutral setting there's nothing to run, not even the interleaving
+        if (isBypassed())
+            return;
+
+        auto channelsToProcess = juce::jmin(block.getNumChannels(), numChannels);
+
+        if (key != nullptr && key->getNumChannels() == 0)
+            key = nullptr;
+
+        auto numGroups = (channelsToProcess + lanes - 1) / lanes;
+
+        if (pool != nullptr && numGroups > 1 && numGroups * block.getNumSamples() >= minParallelGroupSamples)
+        {
+            groupJob.engine = this;
+            groupJob.block = &block;
+            groupJob.key = key;
+            groupJob.channelsToProcess = channelsToProcess;
+            pool->run(groupJob, static_cast<int>(numGroups));
+            return;
+        }
+
+        for (size_t group = 0; group < numGroups; ++group)
+            processGroup(block, key, group, channelsToProcess, scratch.front());
+    }
+
+private:
+    // everything one thread needs to run a group, so groups can run side by side
+    struct Scratch
+    {
+        juce::HeapBlock<char> interleavedData, keyData, discardData;
+        juce::dsp::AudioBlock<Vector> interleaved, keyInterleaved;
+        juce::dsp::AudioBlock<SampleType> discard;
+        juce::HeapBlock<const SampleType*> inputPointers, keyPointers;
+        juce::HeapBlock<SampleType*> outputPointers;
+
+        // only timed while the dynamic band is on, see takeGroupTicks
+        juce::int64 dynamicTicks{ 0 }, groupTicks{ 0 };
+    };
+
+    // one task per group, with the participant picking the scratch buffers
+    struct GroupJob : public WorkerPool::Job
+    {
+        void perform(int taskIndex, int participant) noexcept override
+        {
+            engine->processGroup(*block, key, static_cast<size_t>(taskIndex), channelsToProcess, engine->scratch[static_cast<size_t>(participant)]);
+        }
+
+        FilterEngine* engine{ nullptr };
+        juce::dsp::AudioBlock<SampleType>* block{ nullptr };
+        const juce::dsp::AudioBlock<SampleType>* key{ nullptr };
+        size_t channelsToProcess{ 0 };
+    };
+
+    void processGroup(juce::dsp::AudioBlock<SampleType>& block, const juce::dsp::AudioBlock<SampleType>* key,
+                      size_t group, size_t channelsToProcess, Scratch& buffers)
+    {
+        auto numSamples = block.getNumSamples();
+        auto firstChannel = group * lanes;
+
+        auto& dynamicBand = dynamicBands[group];
+        auto* vectors = buffers.interleaved.getChannelPointer(0);
+        auto* samples = reinterpret_cast<SampleType*>(vectors);
+        auto* keyVectors = buffers.keyInterleaved.getChannelPointer(0);
+
+        auto timeDynamic = dynamicBand.isEnabled();
+        auto groupStart = timeDynamic ? juce::Time::getHighResolutionTicks() : 0;
+
+        // a big block goes through one tile at a time, and each tile runs through every stage
+        // while it's still in L1. The filters carry their state from tile to tile, so the output
+        // is exactly what one pass over the whole block would give.
+        for (size_t start = 0; start < numSamples; start += tileSize)
+        {
+            auto length = juce::jmin(tileSize, numSamples - start);
+
+            interleave(block, firstChannel, channelsToProcess, start, length, buffers);
+
+            if (dynamicBand.isEnabled())
+            {
+                if (dynamicBand.usesSidechain() && key != nullptr)
+                    interleaveKey(*key, firstChannel, channelsToProcess, start, length, buffers);
+                else
+                    std::copy(vectors, vectors + length, keyVectors);
+            }
+
+            cascades[group].process(vectors, length);
+
+            if (dynamicBand.isEnabled())
+            {
+                auto dynamicStart = juce::Time::getHighResolutionTicks();
+                dynamicBand.process(vectors, keyVectors, length);
+                buffers.dynamicTicks += juce::Time::getHighResolutionTicks() - dynamicStart;
+            }
+
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                auto* dest = buffers.outputPointers[lane];
+
+                for (size_t i = 0; i < length; ++i)
+                    dest[i] = samples[i * lanes + lane];
+            }
+        }
+
+        if (timeDynamic)
+            buffers.groupTicks += juce::Time::getHighResolutionTicks() - groupStart;
+    }
+
+    void interleave(juce::dsp::AudioBlock<SampleType>& block, size_t firstChannel, size_t channelsToProcess, size_t start, size_t length,
+                    Scratch& buffers)
+    {
+        auto& inputPointers = buffers.inputPointers;
+        auto& outputPointers = buffers.outputPointers;
+
+        // lanes without a channel (the last group of a 5.1 bus, say) read from the zero block
+        // and write to the discard block, so their tail never gets fed back in
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            auto ch = firstChannel + lane;
+            auto hasChannel = ch < channelsToProcess;
+
+            inputPointers[lane] = hasChannel ? block.getChannelPointer(ch) + start : zero.getChannelPointer(0);
+            outputPointers[lane] = hasChannel ? block.getChannelPointer(ch) + start : buffers.discard.getChannelPointer(0);
+        }
+
+        auto* samples = reinterpret_cast<SampleType*>(buffers.interleaved.getChannelPointer(0));
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            auto* source = inputPointers[lane];
+
+            for (size_t i = 0; i < length; ++i)
+                samples[i * lanes + lane] = source[i];
+        }
+    }
+
+    void interleaveKey(const juce::dsp::AudioBlock<SampleType>& key, size_t firstChannel, size_t channelsToProcess, size_t start, size_t length,
+                       Scratch& buffers)
+    {
+        jassert(start + length <= key.getNumSamples());
+
+        auto* samples = reinterpret_cast<SampleType*>(buffers.keyInterleaved.getChannelPointer(0));
+        auto& keyPointers = buffers.keyPointers;
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            auto ch = firstChannel + lane;
+            keyPointers[lane] = ch < channelsToProcess ? key.getChannelPointer(ch % key.getNumChannels()) + start : zero.getChannelPointer(0);
+        }
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            auto* source = keyPointers[lane];
+
+            for (size_t i = 0; i < length; ++i)
+                samples[i * lanes + lane] = source[i];
+        }
+    }
+
+    size_t numChannels{ 0 }, tileSize{ 1 };
+    std::vector<BiquadCascade<Vector>> cascades;
+    std::vector<DynamicBand<Vector>> dynamicBands;
+
+    // the lanes without a channel all read from the same zeros, nobody writes to them
+    juce::HeapBlock<char> zeroData;
+    juce::dsp::AudioBlock<SampleType> zero;
+    std::vector<Scratch> scratch;
+
+    WorkerPool* pool{ nullptr };
+    GroupJob groupJob;
+};
@@ -0,0 +1,200 @@
+/*
+  ==============================================================================
+    Everything the IIR mode needs at one sample precision: the two filter
+    engines a program change crossfades between, the oversamplers around
+    them and the sidechain held up to the oversampled rate. The processor
+    keeps one for float and one for double and only prepares the one the
+    host is using, so both precisions run the same code.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterEngine.h"
+
+template <typename SampleType>
+class IirPath
+{
+public:
+    using Block = juce::dsp::AudioBlock<SampleType>;
+    static constexpr int maxOversamplingFactor = 8;
+
+    // allocates everything, so call this from prepareToPlay. The pool and the tile size are
+    // optional, see FilterEngine::prepare.
+    void prepare(int numChannels, int numSidechainChannels, int samplesPerBlock, WorkerPool* workerPool = nullptr, int tileSize = 0)
+    {
+        // 2x, 4x and 8x are all set up here so switching between them never allocates.
+        // The polyphase IIR half-band filters are the cheapest of JUCE's oversampling filters.
+        for (size_t i = 0; i < oversamplers.size(); ++i)
+        {
+            oversamplers[i] = std::make_unique<juce::dsp::Oversampling<SampleType>>(static_cast<size_t>(numChannels), i + 1,
+                juce::dsp::Oversampling<SampleType>::filterHalfBandPolyphaseIIR, true, true);
+            oversamplers[i]->initProcessing(static_cast<size_t>(samplesPerBlock));
+        }
+
+        // the channels are grouped into SIMD registers, one sample of each channel per lane,
+        // and each group runs through its own cascade. The engines are sized from the bus
+        // here, with room for the longest oversampled block.
+        auto maxSamples = static_cast<size_t>(samplesPerBlock * maxOversamplingFactor);
+
+        for (auto& filterEngine : engines)
+            filterEngine.prepare(numChannels, static_cast<int>(maxSamples), workerPool, tileSize);
+
+        crossfadeBlock = Block(crossfadeData, static_cast<size_t>(numChannels), maxSamples);
+        oversampledKey = Block(oversampledKeyData, static_cast<size_t>(juce::jmax(1, numSidechainChannels)), maxSamples);
+        crossfadeSamplesRemaining = 0;
+    }
+
+    // frees everything while the other precision is in use. An unprepared path ignores
+    // coefficients and resets, so the processor can keep calling it either way.
+    void release()
+    {
+        for (auto& oversampler : oversamplers)
+            oversampler.reset();
+
+        engines = {};
+        crossfadeData.free();
+        oversampledKeyData.free();
+        crossfadeBlock = {};
+        oversampledKey = {};
+        crossfadeSamplesRemaining = 0;
+    }
+
+    int getNumChannels() const noexcept { return engine->getNumChannels(); }
+
+    // this only copies values into the cascades, nothing is allocated or freed here
+    void setCoefficients(const ChainCoefficients& coefficients) { engine->setCoefficients(coefficients); }
+
+    // audio thread: how much of the engines' time since the last call went on the dynamic
+    // peak, from 0 to 1. Both engines count, so it's right during a program crossfade too.
+    double takeDynamicShare() noexcept
+    {
+        juce::int64 dynamicTicks = 0, totalTicks = 0;
+
+        for (auto& filterEngine : engines)
+            filterEngine.takeGroupTicks(dynamicTicks, totalTicks);
+
+        return totalTicks > 0 ? static_cast<double>(dynamicTicks) / static_cast<double>(totalTicks) : 0.0;
+    }
+
+    juce::dsp::Oversampling<SampleType>* getOversampler(int factor) const noexcept
+    {
+        switch (factor)
+        {
+            case 2: return oversamplers[0].get();
+            case 4: return oversamplers[1].get();
+            case 8: return oversamplers[2].get();
+            default: return nullptr;
+        }
+    }
+
+    int getLatencySamples(int factor) const
+    {
+        auto* oversampler = getOversampler(factor);
+        return oversampler != nullptr ? juce::roundToInt(oversampler->getLatencyInSamples()) : 0;
+    }
+
+    // clears all the filter state, nothing allocates
+    void reset()
+    {
+        for (auto& filterEngine : engines)
+            filterEngine.reset();
+
+        for (auto& oversampler : oversamplers)
+            if (oversampler != nullptr)
+                oversampler->reset();
+
+        crossfadeSamplesRemaining = 0;
+    }
+
+    // the newly active oversampler and the cascade start from silence
+    void switchOversampling(int factor)
+    {
+        if (auto* oversampler = getOversampler(factor))
+            oversampler->reset();
+
+        engine->reset();
+        crossfadeSamplesRemaining = 0;
+    }
+
+    // a second change in the middle of a crossfade cuts the oldest program off where it is
+    void startCrossfade(const ChainCoefficients& coefficients, int lengthInSamples)
+    {
+        std::swap(engine, fadingEngine);
+        engine->reset();
+        engine->setCoefficients(coefficients);
+
+        crossfadeLength = juce::jmax(1, lengthInSamples);
+        crossfadeSamplesRemaining = crossfadeLength;
+    }
+
+    void stopCrossfade() noexcept { crossfadeSamplesRemaining = 0; }
+
+    // the detector only needs the key's level around the peak frequency, so holding each
+    // sample for the oversampling factor is plenty and costs next to nothing
+    Block holdKey(const Block& key, int factor)
+    {
+        auto held = oversampledKey.getSubsetChannelBlock(0, key.getNumChannels()).getSubBlock(0, key.getNumSamples() * static_cast<size_t>(factor));
+
+        for (size_t ch = 0; ch < key.getNumChannels(); ++ch)
+        {
+            auto* source = key.getChannelPointer(ch);
+            auto* dest = held.getChannelPointer(ch);
+
+            for (size_t i = 0; i < key.getNumSamples(); ++i)
+                std::fill_n(dest + i * static_cast<size_t>(factor), factor, source[i]);
+        }
+
+        return held;
+    }
+
+    // every biquad runs once per sample for a whole group of channels,
+    // and all of the active sections are applied in the same pass
+    void process(Block& block, const Block& key)
+    {
+        if (crossfadeSamplesRemaining <= 0)
+        {
+            engine->process(block, &key);
+            return;
+        }
+
+        // during a program change the old program runs on a copy of the input and is faded out
+        // under the new one. Both chains see the same signal, so a linear fade keeps the level.
+        auto numSamples = block.getNumSamples();
+        auto fadeBlock = crossfadeBlock.getSubsetChannelBlock(0, block.getNumChannels()).getSubBlock(0, numSamples);
+
+        fadeBlock.copyFrom(block);
+        fadingEngine->process(fadeBlock, &key);
+        engine->process(block, &key);
+
+        auto step = static_cast<SampleType>(1) / static_cast<SampleType>(crossfadeLength);
+        auto startGain = static_cast<SampleType>(crossfadeSamplesRemaining) * step;
+        auto numToFade = juce::jmin(static_cast<int>(numSamples), crossfadeSamplesRemaining);
+
+        for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+        {
+            auto* output = block.getChannelPointer(ch);
+            auto* old = fadeBlock.getChannelPointer(ch);
+
+            for (int i = 0; i < numToFade; ++i)
+                output[i] += (startGain - static_cast<SampleType>(i) * step) * (old[i] - output[i]);
+        }
+
+        crossfadeSamplesRemaining -= numToFade;
+    }
+
+private:
+    // low cut, peak and high cut as one cascade, plus the spare engine a program change swaps in
+    std::array<FilterEngine<SampleType>, 2> engines;
+    FilterEngine<SampleType>* engine{ &engines[0] };
+    FilterEngine<SampleType>* fadingEngine{ &engines[1] };
+
+    juce::HeapBlock<char> crossfadeData;
+    Block crossfadeBlock;
+    int crossfadeLength{ 0 }, crossfadeSamplesRemaining{ 0 };
+
+    std::array<std::unique_ptr<juce::dsp::Oversampling<SampleType>>, 3> oversamplers;
+
+    juce::HeapBlock<char> oversampledKeyData;
+    Block oversampledKey;
+};
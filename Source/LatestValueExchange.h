@@ -0,0 +1,42 @@
+/*
+  ==============================================================================
+    A triple buffer used to hand the newest value from one writer thread to
+    one reader thread without locks or allocation.
+  ==============================================================================
+*/
+#pragma once
+
+#include <array>
+#include <atomic>
+
+template <typename ValueType>
+class LatestValueExchange
+{
+public:
+    // writer side: copies the value into the back slot and swaps it into the middle
+    void publish(const ValueType& value)
+    {
+        slots[writeIndex] = value;
+        writeIndex = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // reader side: returns nullptr if nothing new has been published since the last call.
+    // the returned slot belongs to the reader until the next call to pull(), so it can
+    // be swapped out of rather than copied.
+    ValueType* pull()
+    {
+        if ((middle.load(std::memory_order_acquire) & freshBit) == 0)
+            return nullptr;
+
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+        return &slots[readIndex];
+    }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int freshBit = 4;
+
+    std::array<ValueType, 3> slots;
+    std::atomic<int> middle{ 1 };
+    int writeIndex{ 0 }, readIndex{ 2 };
+};
@@ -0,0 +1,252 @@
+/*
+  ==============================================================================
+    Linear-phase mode: builds a symmetric FIR kernel with the same magnitude
+    response as the IIR chain and runs it through juce::dsp::Convolution
+    (uniformly partitioned FFT convolution). Kernels are built on the
+    designer thread and the convolution crossfades to each new one.
+  ==============================================================================
+*/
+#include "LinearPhaseEngine.h"
+
+namespace
+{
+    // about 170 ms of kernel whatever the sample rate, which resolves a 20 Hz low cut
+    int kernelOrderFor(double sampleRate)
+    {
+        return juce::jlimit(10, 17, static_cast<int>(std::ceil(std::log2(sampleRate / 6.0))));
+    }
+}
+
+void LinearPhaseEngine::prepare(const juce::dsp::ProcessSpec& newSpec)
+{
+    auto wasActive = isActive();
+    deactivate();
+
+    spec = newSpec;
+    kernelOrder = kernelOrderFor(spec.sampleRate);
+
+    // one extra tap makes the kernel odd length, so it is exactly symmetric around fftSize / 2
+    kernelSize = (1 << kernelOrder) + 1;
+
+    if (wasActive)
+        activate();
+}
+
+void LinearPhaseEngine::activate()
+{
+    const juce::ScopedLock sl(resourceLock);
+
+    if (isActive() || spec.numChannels == 0)
+        return;
+
+    auto fftSize = 1 << kernelOrder;
+
+    fft = std::make_unique<juce::dsp::FFT>(kernelOrder);
+    fftData.assign(static_cast<size_t>(fftSize) * 2, 0.f);
+
+    // the kernel only needs the magnitude at each bin up to Nyquist
+    std::vector<double> omegas;
+
+    for (int bin = 0; bin <= fftSize / 2; ++bin)
+        omegas.push_back(juce::MathConstants<double>::twoPi * bin / fftSize);
+
+    response.setFrequencies(omegas);
+    magnitudes.assign(omegas.size(), 0.0);
+
+    window.assign(static_cast<size_t>(kernelSize), 0.f);
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), static_cast<size_t>(kernelSize),
+                                                             juce::dsp::WindowingFunction<float>::blackman, false);
+
+    for (juce::uint32 ch = 0; ch < spec.numChannels; ch += 2)
+    {
+        auto pairSpec = spec;
+        pairSpec.numChannels = juce::jmin(2u, spec.numChannels - ch);
+
+        // zero latency uniform partitioning keeps the cost of every block the same
+        auto convolution = std::make_unique<juce::dsp::Convolution>(*messageQueue);
+        convolution->prepare(pairSpec);
+        convolutions.push_back(std::move(convolution));
+    }
+
+    convolutionLatency = convolutions.empty() ? 0 : convolutions.front()->getLatency();
+
+    conversionBlock = juce::dsp::AudioBlock<float>(conversionData, spec.numChannels, spec.maximumBlockSize);
+
+    active.store(true);
+}
+
+void LinearPhaseEngine::deactivate()
+{
+    const juce::ScopedLock sl(resourceLock);
+
+    if (!isActive())
+        return;
+
+    // the audio thread raises inUse before it looks at active, so once it's seen to be down
+    // here nothing can start using the engine again. It never takes the lock, so waiting here is fine.
+    active.store(false);
+
+    while (inUse.load())
+        juce::Thread::yield();
+
+    freeResources();
+}
+
+void LinearPhaseEngine::freeResources()
+{
+    convolutions.clear();
+    fft.reset();
+    fftData = {};
+    window = {};
+    magnitudes = {};
+    response = {};
+    conversionData.free();
+    conversionBlock = {};
+}
+
+bool LinearPhaseEngine::beginBlock() noexcept
+{
+    inUse.store(true);
+
+    if (active.load())
+        return true;
+
+    inUse.store(false);
+    return false;
+}
+
+void LinearPhaseEngine::reset()
+{
+    if (!beginBlock())
+        return;
+
+    for (auto& convolution : convolutions)
+        convolution->reset();
+
+    endBlock();
+}
+
+bool LinearPhaseEngine::waitForKernel(int timeoutMs)
+{
+    if (!beginBlock())
+        return true;
+
+    auto isLoaded = [this]
+    {
+        return std::all_of(convolutions.begin(), convolutions.end(), [this](const std::unique_ptr<juce::dsp::Convolution>& convolution)
+        {
+            return convolution->getCurrentIRSize() == kernelSize;
+        });
+    };
+
+    // the convolution only picks up a loaded kernel while it's processing
+    auto silence = conversionBlock.getSubBlock(0, juce::jmin(static_cast<size_t>(64), conversionBlock.getNumSamples()));
+    auto deadline = juce::Time::getMillisecondCounter() + static_cast<juce::uint32>(timeoutMs);
+    auto loaded = isLoaded();
+
+    while (!loaded && juce::Time::getMillisecondCounter() < deadline)
+    {
+        silence.clear();
+
+        for (size_t pair = 0; pair < convolutions.size(); ++pair)
+        {
+            auto pairBlock = silence.getSubsetChannelBlock(pair * 2, juce::jmin(static_cast<size_t>(2), silence.getNumChannels() - pair * 2));
+            convolutions[pair]->process(juce::dsp::ProcessContextReplacing<float>(pairBlock));
+        }
+
+        loaded = isLoaded();
+
+        if (!loaded)
+            juce::Thread::sleep(1);
+    }
+
+    // nothing of the old kernel or the crossfade to the new one is left to come out
+    for (auto& convolution : convolutions)
+        convolution->reset();
+
+    endBlock();
+    return loaded;
+}
+
+void LinearPhaseEngine::buildKernel(const ChainCoefficients& coefficients)
+{
+    const juce::ScopedLock sl(resourceLock);
+
+    if (fft == nullptr)
+        return;
+
+    auto fftSize = fft->getSize();
+    auto half = fftSize / 2;
+
+    // zero phase spectrum with the chain's magnitude at every bin
+    std::fill(fftData.begin(), fftData.end(), 0.f);
+
+    response.evaluate(coefficients, magnitudes.data());
+
+    double expectedCentre = 0;
+
+    for (int bin = 0; bin <= half; ++bin)
+    {
+        auto magnitude = magnitudes[static_cast<size_t>(bin)];
+
+        fftData[static_cast<size_t>(bin) * 2] = static_cast<float>(magnitude);
+
+        expectedCentre += (bin == 0 || bin == half) ? magnitude : 2.0 * magnitude;
+    }
+
+    fft->performRealOnlyInverseTransform(fftData.data());
+
+    // the centre tap of a zero phase response is the mean of the spectrum,
+    // scaling to that keeps the gain right whatever the FFT's own scaling is
+    expectedCentre /= fftSize;
+    auto scale = fftData[0] != 0.f ? static_cast<float>(expectedCentre / fftData[0]) : 0.f;
+
+    // rotate so the impulse sits in the middle of the kernel, then window it
+    juce::AudioBuffer<float> kernel(1, kernelSize);
+    auto sampleRate = spec.sampleRate;
+    auto* taps = kernel.getWritePointer(0);
+
+    for (int n = 0; n < kernelSize; ++n)
+    {
+        auto index = ((n - half) % fftSize + fftSize) % fftSize;
+        taps[n] = fftData[static_cast<size_t>(index)] * scale * window[static_cast<size_t>(n)];
+    }
+
+    // the convolution loads and swaps the kernel on its own background thread and crossfades to it
+    for (auto& convolution : convolutions)
+    {
+        juce::AudioBuffer<float> copy(kernel);
+        convolution->loadImpulseResponse(std::move(copy), sampleRate,
+                                         juce::dsp::Convolution::Stereo::no,
+                                         juce::dsp::Convolution::Trim::no,
+                                         juce::dsp::Convolution::Normalise::no);
+    }
+}
+
+void LinearPhaseEngine::process(juce::dsp::AudioBlock<float>& block)
+{
+    auto numChannels = block.getNumChannels();
+
+    for (size_t pair = 0; pair < convolutions.size() && pair * 2 < numChannels; ++pair)
+    {
+        auto subBlock = block.getSubsetChannelBlock(pair * 2, juce::jmin(static_cast<size_t>(2), numChannels - pair * 2));
+        convolutions[pair]->process(juce::dsp::ProcessContextReplacing<float>(subBlock));
+    }
+}
+
+void LinearPhaseEngine::process(juce::dsp::AudioBlock<double>& block)
+{
+    auto numChannels = juce::jmin(block.getNumChannels(), conversionBlock.getNumChannels());
+    auto numSamples = block.getNumSamples();
+    jassert(numSamples <= conversionBlock.getNumSamples());
+
+    auto floatBlock = conversionBlock.getSubsetChannelBlock(0, numChannels).getSubBlock(0, numSamples);
+
+    for (size_t ch = 0; ch < numChannels; ++ch)
+        std::copy_n(block.getChannelPointer(ch), numSamples, floatBlock.getChannelPointer(ch));
+
+    process(floatBlock);
+
+    for (size_t ch = 0; ch < numChannels; ++ch)
+        std::copy_n(floatBlock.getChannelPointer(ch), numSamples, block.getChannelPointer(ch));
+}
@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+    Linear-phase mode: builds a symmetric FIR kernel with the same magnitude
+    response as the IIR chain and runs it through juce::dsp::Convolution
+    (uniformly partitioned FFT convolution). Kernels are built on the
+    designer thread and the convolution crossfades to each new one.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadDesign.h"
+#include "MagnitudeResponse.h"
+
+class LinearPhaseEngine
+{
+public:
+    // only keeps the spec and works out the kernel size, nothing is allocated until activate().
+    // If the engine was active it's set up again for the new spec. Call it from prepareToPlay.
+    void prepare(const juce::dsp::ProcessSpec& spec);
+
+    // not the audio thread: allocates the FFT and the convolutions, or frees them again. Nothing of
+    // either is kept while linear phase is off, which at a few hundred instances adds up.
+    void activate();
+    void deactivate();
+    bool isActive() const noexcept { return active.load(); }
+
+    // audio thread: claims the engine for one block, false if it isn't active. Between the two
+    // calls deactivate() waits rather than free anything that's in use.
+    bool beginBlock() noexcept;
+    void endBlock() noexcept { inUse.store(false); }
+
+    void reset();
+
+    // offline only, with nothing else processing: runs silence through the convolutions until the
+    // newest kernel has been loaded in the background and swapped in, then clears them again.
+    // Returns false if that took longer than timeoutMs.
+    bool waitForKernel(int timeoutMs);
+
+    // the kernel is centred, so everything comes out half a kernel late
+    int getLatencySamples() const noexcept { return kernelSize / 2 + convolutionLatency; }
+
+    // the latency plus the other half of the kernel
+    int getTailLengthSamples() const noexcept { return kernelSize + convolutionLatency; }
+
+    // designer (or message) thread: turns the chain's magnitude response into a kernel and queues it up.
+    // Does nothing while the engine isn't active.
+    void buildKernel(const ChainCoefficients& coefficients);
+
+    void process(juce::dsp::AudioBlock<float>& block);
+
+    // the convolution only runs in float, so a double block goes through a float copy
+    void process(juce::dsp::AudioBlock<double>& block);
+
+private:
+    void freeResources();
+
+    juce::dsp::ProcessSpec spec{ 44100.0, 0, 0 };
+    int kernelOrder{ 10 };
+    int kernelSize{ 0 };
+    int convolutionLatency{ 0 };
+
+    std::atomic<bool> active{ false }, inUse{ false };
+
+    // kernels are built on the designer thread while the message thread (or prepareToPlay) may be
+    // setting up or freeing
+    juce::CriticalSection resourceLock;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> fftData, window;
+
+    MagnitudeResponse response;
+    std::vector<double> magnitudes;
+
+    // one background thread loads the kernels for every convolution in every instance
+    juce::SharedResourcePointer<juce::dsp::ConvolutionMessageQueue> messageQueue;
+
+    // juce::dsp::Convolution handles up to two channels, so wider buses get one per pair
+    std::vector<std::unique_ptr<juce::dsp::Convolution>> convolutions;
+
+    juce::HeapBlock<char> conversionData;
+    juce::dsp::AudioBlock<float> conversionBlock;
+};
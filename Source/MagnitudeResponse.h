@@ -0,0 +1,77 @@
+/*
+  ==============================================================================
+    Evaluates the magnitude response of a whole chain over a fixed set of
+    frequencies. cos(w) and cos(2w) are worked out once per frequency, after
+    that every section is a flat loop over plain arrays, which the compiler
+    vectorises.
+  ==============================================================================
+*/
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include "BiquadDesign.h"
+
+class MagnitudeResponse
+{
+public:
+    // omegas are in radians per sample (2 pi f / sampleRate). Allocates, so not for the audio thread.
+    void setFrequencies(const std::vector<double>& omegas)
+    {
+        cosW.resize(omegas.size());
+        cos2W.resize(omegas.size());
+
+        for (size_t i = 0; i < omegas.size(); ++i)
+        {
+            cosW[i] = std::cos(omegas[i]);
+            cos2W[i] = std::cos(2.0 * omegas[i]);
+        }
+
+        squared.resize(omegas.size());
+    }
+
+    size_t getNumFrequencies() const noexcept { return cosW.size(); }
+
+    // writes |H| of the whole chain at every frequency into magnitudes, which must have
+    // getNumFrequencies() elements
+    void evaluate(const ChainCoefficients& chain, double* magnitudes)
+    {
+        std::fill(squared.begin(), squared.end(), 1.0);
+
+        if (chain.peakActive)
+            multiplySquared(chain.peak);
+
+        for (int i = 0; i < chain.numLowCut; ++i)
+            multiplySquared(chain.lowCut[static_cast<size_t>(i)]);
+
+        for (int i = 0; i < chain.numHighCut; ++i)
+            multiplySquared(chain.highCut[static_cast<size_t>(i)]);
+
+        for (int i = 0; i < chain.numBands; ++i)
+            multiplySquared(chain.bands[static_cast<size_t>(i)]);
+
+        for (size_t i = 0; i < squared.size(); ++i)
+            magnitudes[i] = std::sqrt(squared[i]);
+    }
+
+private:
+    // |H(e^jw)|^2 of one biquad written in terms of cos(w) and cos(2w), so there is no
+    // complex arithmetic and no branching inside the loop
+    void multiplySquared(const BiquadCoefficients& c)
+    {
+        const double b0 = c.b0, b1 = c.b1, b2 = c.b2, a1 = c.a1, a2 = c.a2;
+
+        const auto n0 = b0 * b0 + b1 * b1 + b2 * b2, n1 = 2.0 * (b0 * b1 + b1 * b2), n2 = 2.0 * b0 * b2;
+        const auto d0 = 1.0 + a1 * a1 + a2 * a2, d1 = 2.0 * (a1 + a1 * a2), d2 = 2.0 * a2;
+
+        const auto num = squared.size();
+        const auto* cw = cosW.data();
+        const auto* c2w = cos2W.data();
+        auto* out = squared.data();
+
+        for (size_t i = 0; i < num; ++i)
+            out[i] *= (n0 + n1 * cw[i] + n2 * c2w[i]) / (d0 + d1 * cw[i] + d2 * c2w[i]);
+    }
+
+    std::vector<double> cosW, cos2W, squared;
+};
@@ -0,0 +1,37 @@
+/*
+  ==============================================================================
+    Times paint() calls so the editor can show what repainting costs.
+    Message thread only.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+
+class PaintStatistics
+{
+public:
+    // times the scope it lives in, put one at the top of paint()
+    struct ScopedMeasurement
+    {
+        explicit ScopedMeasurement(PaintStatistics& s) : statistics(s) {}
+        ~ScopedMeasurement() { statistics.add(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1000.0); }
+
+        PaintStatistics& statistics;
+        juce::int64 start{ juce::Time::getHighResolutionTicks() };
+    };
+
+    double getAverageMs() const noexcept { return averageMs; }
+    double getWorstMs() const noexcept { return worstMs; }
+    juce::int64 getNumPaints() const noexcept { return numPaints; }
+
+private:
+    void add(double ms) noexcept
+    {
+        worstMs = juce::jmax(worstMs, ms);
+        averageMs = numPaints++ == 0 ? ms : averageMs + 0.05 * (ms - averageMs);
+    }
+
+    double averageMs{ 0 }, worstMs{ 0 };
+    juce::int64 numPaints{ 0 };
+};
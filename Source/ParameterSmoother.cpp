@@ -0,0 +1,100 @@
+/*
+  ==============================================================================
+    Ramps the continuous filter parameters and redesigns the coefficients every
+    few samples (the control rate), so parameter moves sweep smoothly instead
+    of jumping at the host's block boundaries.
+  ==============================================================================
+*/
+#include "ParameterSmoother.h"
+
+void ParameterSmoother::prepare(double newSampleRate, const chainsettings& initialSettings)
+{
+    sampleRate = newSampleRate;
+
+    peakFreq.reset(sampleRate, rampLengthSeconds);
+    peakGain.reset(sampleRate, rampLengthSeconds);
+    peakQuality.reset(sampleRate, rampLengthSeconds);
+    lowCutFreq.reset(sampleRate, rampLengthSeconds);
+    highCutFreq.reset(sampleRate, rampLengthSeconds);
+
+    // start exactly on the current values so there's no ramp after a prepare
+    peakFreq.setCurrentAndTargetValue(initialSettings.peakFreq);
+    peakGain.setCurrentAndTargetValue(initialSettings.peakGain);
+    peakQuality.setCurrentAndTargetValue(initialSettings.peakQuality);
+    lowCutFreq.setCurrentAndTargetValue(initialSettings.lowCutFreq);
+    highCutFreq.setCurrentAndTargetValue(initialSettings.highCutFreq);
+
+    for (size_t i = 0; i < bands.size(); ++i)
+    {
+        auto& ramps = bands[i];
+        const auto& band = initialSettings.bands[i];
+
+        ramps.freq.reset(sampleRate, rampLengthSeconds);
+        ramps.gain.reset(sampleRate, rampLengthSeconds);
+        ramps.quality.reset(sampleRate, rampLengthSeconds);
+
+        ramps.freq.setCurrentAndTargetValue(band.freq);
+        ramps.gain.setCurrentAndTargetValue(band.gain);
+        ramps.quality.setCurrentAndTargetValue(band.quality);
+    }
+
+    latest = initialSettings;
+
+    current = makeChainCoefficients(initialSettings, sampleRate);
+}
+
+void ParameterSmoother::setTargets(const chainsettings& targets)
+{
+    peakFreq.setTargetValue(targets.peakFreq);
+    peakGain.setTargetValue(targets.peakGain);
+    peakQuality.setTargetValue(targets.peakQuality);
+    lowCutFreq.setTargetValue(targets.lowCutFreq);
+    highCutFreq.setTargetValue(targets.highCutFreq);
+
+    for (size_t i = 0; i < bands.size(); ++i)
+    {
+        bands[i].freq.setTargetValue(targets.bands[i].freq);
+        bands[i].gain.setTargetValue(targets.bands[i].gain);
+        bands[i].quality.setTargetValue(targets.bands[i].quality);
+    }
+
+    // the slopes, the band types and the dynamic settings are steps, so they just switch over
+    latest = targets;
+}
+
+bool ParameterSmoother::isSmoothing() const
+{
+    if (peakFreq.isSmoothing() || peakGain.isSmoothing() || peakQuality.isSmoothing()
+        || lowCutFreq.isSmoothing() || highCutFreq.isSmoothing())
+        return true;
+
+    return std::any_of(bands.begin(), bands.end(), [](const BandRamps& ramps)
+    {
+        return ramps.freq.isSmoothing() || ramps.gain.isSmoothing() || ramps.quality.isSmoothing();
+    });
+}
+
+const ChainCoefficients& ParameterSmoother::advance(int numSamples)
+{
+    auto settings = latest;
+
+    settings.peakFreq = peakFreq.skip(numSamples);
+    settings.peakGain = peakGain.skip(numSamples);
+    settings.peakQuality = peakQuality.skip(numSamples);
+    settings.lowCutFreq = lowCutFreq.skip(numSamples);
+    settings.highCutFreq = highCutFreq.skip(numSamples);
+
+    for (size_t i = 0; i < bands.size(); ++i)
+    {
+        settings.bands[i].freq = bands[i].freq.skip(numSamples);
+        settings.bands[i].gain = bands[i].gain.skip(numSamples);
+        settings.bands[i].quality = bands[i].quality.skip(numSamples);
+    }
+
+    // closed-form designs only, one sin/cos for the peak, one tan per cut and one per band that's on.
+    // Flat stages are kept while the ramps run, one that passes through a flat setting mustn't drop
+    // sections and their state halfway through. The last step of a ramp has reached the targets,
+    // so that one leaves them out and the cascade doesn't keep running them after the ramp.
+    current = makeChainCoefficients(settings, sampleRate, isSmoothing());
+    return current;
+}
@@ -0,0 +1,51 @@
+/*
+  ==============================================================================
+    Ramps the continuous filter parameters and redesigns the coefficients every
+    few samples (the control rate), so parameter moves sweep smoothly instead
+    of jumping at the host's block boundaries.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChainSettings.h"
+#include "CoefficientDesigner.h"
+
+class ParameterSmoother
+{
+public:
+    void prepare(double sampleRate, const chainsettings& initialSettings);
+
+    // how many samples to process between coefficient updates while ramping
+    void setControlInterval(int numSamples) { controlInterval = juce::jmax(1, numSamples); }
+    int getControlInterval() const { return controlInterval; }
+
+    void setTargets(const chainsettings& targets);
+    bool isSmoothing() const;
+
+    // moves the ramps on by numSamples and returns the coefficients for that point
+    const ChainCoefficients& advance(int numSamples);
+
+private:
+    static constexpr double rampLengthSeconds = 0.05;
+
+    // the frequencies and Q ramp multiplicatively so a sweep sounds even across the octaves
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> peakFreq, peakQuality, lowCutFreq, highCutFreq;
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> peakGain;
+
+    // every band ramps whether it's on or not, so one that's switched on starts from where it's set
+    struct BandRamps
+    {
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> freq, quality;
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> gain;
+    };
+
+    std::array<BandRamps, maxBands> bands;
+
+    chainsettings latest;
+
+    double sampleRate{ 44100.0 };
+    int controlInterval{ 32 };
+
+    ChainCoefficients current;
+};
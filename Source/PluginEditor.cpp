@@ -32,7 +32,32 @@ EQAudioProcessorEditor::EQAudioProcessorEditor(EQAudioProcessor& p)
     addAndMakeVisible(lowCutSlopeSlider);
     addAndMakeVisible(highCutSlopeSlider);
 
+    // the analyzer sits behind the curve, and only costs anything while the button is on
+    addAndMakeVisible(analyzer);
+    addAndMakeVisible(responseCurve);
+
+    analyzerButton.setToggleState(analyzer.isAnalyzerOn(), juce::dontSendNotification);
+    analyzerButton.setColour(juce::ToggleButton::textColourId, juce::Colours::lightgrey);
+    analyzerButton.onClick = [this] { analyzer.setAnalyzerOn(analyzerButton.getToggleState()); };
+    addAndMakeVisible(analyzerButton);
+
+    matchButton.setTooltip("Fits the cuts, the peak and up to " + juce::String(matchBands)
+                           + " bands so the material's average spectrum matches a reference's");
+    matchButton.onClick = [this] { chooseMatchFiles(); };
+    addAndMakeVisible(matchButton);
+
+    loadLabel.setJustificationType(juce::Justification::centredRight);
+    loadLabel.setColour(juce::Label::textColourId, juce::Colours::lightgrey);
+    addAndMakeVisible(loadLabel);
+
+    // the cached background covers every pixel, so nothing behind the editor needs painting
+    setOpaque(true);
     setSize(1200, 900);
+
+    // the load statistics are read a few times a second, the meter keeps them up to date itself.
+    // The same timer picks up a finished match.
+    startTimerHz(4);
+    updateMatch();
 }
 
 EQAudioProcessorEditor::~EQAudioProcessorEditor()
@@ -42,88 +67,40 @@ EQAudioProcessorEditor::~EQAudioProcessorEditor()
 //==============================================================================
 void EQAudioProcessorEditor::paint(juce::Graphics& g)
 {
-    // (Our component is opaque, so we must completely fill the background with a solid colour)  
- 
-    auto bounds = getLocalBounds();
-    auto responseArea = bounds.removeFromTop(bounds.getHeight() * 0.33);
-    auto freqAreaBounds = bounds.removeFromTop(bounds.getHeight() * 0.5);
-
-    auto lowCutArea = freqAreaBounds.removeFromLeft(bounds.getWidth() * 0.5);
-    auto highCutArea = freqAreaBounds;
-
-
-
-
-    auto lowCutFreqArea = lowCutArea.removeFromLeft(lowCutArea.getWidth() * 0.5);
-    auto lowCutFreqArea1 = lowCutFreqArea.removeFromLeft(lowCutFreqArea.getWidth() * 0.95);
-    auto lowCutFreqArea2 = lowCutFreqArea1.removeFromRight(lowCutFreqArea1.getWidth() * 0.9025);
-    auto lowCutFreqArea3 = lowCutFreqArea2.removeFromTop(lowCutFreqArea2.getWidth() * 0.95);
-    auto lowCutFreqArea4 = lowCutFreqArea3.removeFromBottom(lowCutFreqArea3.getWidth() * 0.9025);
-
-
-
-    auto lowCutSlopeArea = lowCutArea;
-    auto lowCutSlopeArea1 = lowCutSlopeArea.removeFromLeft(lowCutSlopeArea.getWidth() * 0.95);
-    auto lowCutSlopeArea2 = lowCutSlopeArea1.removeFromRight(lowCutSlopeArea1.getWidth() * 0.9025);
-    auto lowCutSlopeArea3 = lowCutSlopeArea2.removeFromTop(lowCutSlopeArea2.getWidth() * 0.95);
-    auto lowCutSlopeArea4 = lowCutSlopeArea3.removeFromBottom(lowCutSlopeArea3.getWidth() * 0.9025);
-
-
-    auto highCutFreqArea = highCutArea.removeFromLeft(highCutArea.getWidth() * 0.5);
-    auto highCutFreqArea1 = highCutFreqArea.removeFromLeft(highCutFreqArea.getWidth() * 0.95);
-    auto highCutFreqArea2 = highCutFreqArea1.removeFromRight(highCutFreqArea1.getWidth() * 0.9025);
-    auto highCutFreqArea3 = highCutFreqArea2.removeFromTop(highCutFreqArea2.getWidth() * 0.95);
-    auto highCutFreqArea4 = highCutFreqArea3.removeFromBottom(highCutFreqArea3.getWidth() * 0.9025);
-
-    auto highCutSlopeArea = highCutArea;
-    auto highCutSlopeArea1 = highCutSlopeArea.removeFromLeft(highCutSlopeArea.getWidth() * 0.95);
-    auto highCutSlopeArea2 = highCutSlopeArea1.removeFromRight(highCutSlopeArea1.getWidth() * 0.9025);
-    auto highCutSlopeArea3 = highCutSlopeArea2.removeFromTop(highCutSlopeArea2.getWidth() * 0.95);
-    auto highCutSlopeArea4 = highCutSlopeArea3.removeFromBottom(highCutSlopeArea3.getWidth() * 0.9025);
-
-
-    auto peakQualityArea = bounds.removeFromLeft(bounds.getWidth() * 0.33);
-    auto peakQualityArea1 = peakQualityArea.removeFromLeft(peakQualityArea.getWidth() * 0.95);
-    auto peakQualityArea2 = peakQualityArea1.removeFromRight(peakQualityArea1.getWidth() * 0.9025);
-    auto peakQualityArea3 = peakQualityArea2.removeFromTop(peakQualityArea2.getWidth() * 0.95);
-    auto peakQualityArea4 = peakQualityArea3.removeFromBottom(peakQualityArea3.getWidth() * 0.9025);
+    PaintStatistics::ScopedMeasurement measurement(paintStatistics);
 
+    // the background, labels and title never change between layouts, so they're drawn
+    // once into an image and only redrawn when the size or the display scale changes
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
 
-    auto peakFreqArea = bounds.removeFromRight(bounds.getWidth() * 0.5);
-    auto peakFreqArea1 = peakFreqArea.removeFromLeft(peakFreqArea.getWidth() * 0.95);
-    auto peakFreqArea2 = peakFreqArea1.removeFromRight(peakFreqArea1.getWidth() * 0.9025);
-    auto peakFreqArea3 = peakFreqArea2.removeFromTop(peakFreqArea2.getWidth() * 0.95);
-    auto peakFreqArea4 = peakFreqArea3.removeFromBottom(peakFreqArea3.getWidth() * 0.9025);
+    if (!background.isValid() || scale != backgroundScale)
+        renderBackground(scale);
 
-    auto peakGainArea = bounds;
-    auto peakGainArea1 = peakGainArea.removeFromLeft(peakGainArea.getWidth() * 0.95);
-    auto peakGainArea2 = peakGainArea1.removeFromRight(peakGainArea1.getWidth() * 0.9025);
-    auto peakGainArea3 = peakGainArea2.removeFromTop(peakGainArea2.getWidth() * 0.95);
-    auto peakGainArea4 = (peakGainArea3.removeFromBottom(peakGainArea3.getWidth() * 0.9025));
+    g.drawImage(background, getLocalBounds().toFloat());
+}
 
-    lowCutFreqSlider.setBounds(lowCutFreqArea4);
-    highCutFreqSlider.setBounds(highCutFreqArea4);
+void EQAudioProcessorEditor::renderBackground(float scale)
+{
+    backgroundScale = scale;
+    background = juce::Image(juce::Image::RGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+                             juce::jmax(1, juce::roundToInt(getHeight() * scale)), false);
 
-    lowCutSlopeSlider.setBounds(lowCutSlopeArea4);
-    highCutSlopeSlider.setBounds(highCutSlopeArea4);
+    juce::Graphics g(background);
+    g.addTransform(juce::AffineTransform::scale(scale));
 
-    peakFreqSlider.setBounds(peakFreqArea4);
-    peakGainSlider.setBounds(peakGainArea4);
-    peakQualitySlider.setBounds(peakQualityArea4);
     g.fillAll(juce::Colours::black);
     g.setColour(juce::Colours::white);
     g.setFont(15.0f);
-    g.drawFittedText("Low Cut Frequency",lowCutFreqArea4, juce::Justification::centred, 1);
-    g.drawFittedText("High Cut Frequency", highCutFreqArea4, juce::Justification::centred, 1);
-    g.drawFittedText("Low Cut Slope", lowCutSlopeArea4, juce::Justification::centred, 1);
-    g.drawFittedText("High Cut Slope", highCutSlopeArea4, juce::Justification::centred, 1);
-    g.drawFittedText("Peak Frequency", peakFreqArea4, juce::Justification::centred, 1);
-    g.drawFittedText("Peak Gain", peakGainArea4, juce::Justification::centred, 1);
-    g.drawFittedText("Peak Quality", peakQualityArea4, juce::Justification::centred, 1);
+    g.drawFittedText("Low Cut Frequency", lowCutFreqSlider.getBounds(), juce::Justification::centred, 1);
+    g.drawFittedText("High Cut Frequency", highCutFreqSlider.getBounds(), juce::Justification::centred, 1);
+    g.drawFittedText("Low Cut Slope", lowCutSlopeSlider.getBounds(), juce::Justification::centred, 1);
+    g.drawFittedText("High Cut Slope", highCutSlopeSlider.getBounds(), juce::Justification::centred, 1);
+    g.drawFittedText("Peak Frequency", peakFreqSlider.getBounds(), juce::Justification::centred, 1);
+    g.drawFittedText("Peak Gain", peakGainSlider.getBounds(), juce::Justification::centred, 1);
+    g.drawFittedText("Peak Quality", peakQualitySlider.getBounds(), juce::Justification::centred, 1);
     g.setFont(45.0f);
     g.setColour(juce::Colours::lightblue);
-    g.drawFittedText("3 Band Parametric EQ", responseArea, juce::Justification::centred, 1);
-    
+    g.drawFittedText("3 Band Parametric EQ", titleArea, juce::Justification::centred, 1);
 }
 
 void EQAudioProcessorEditor::resized()
@@ -133,6 +110,7 @@ void EQAudioProcessorEditor::resized()
     
     auto bounds = getLocalBounds();
     auto responseArea = bounds.removeFromTop(bounds.getHeight() * 0.33);
+    titleArea = responseArea;
     auto freqAreaBounds = bounds.removeFromTop(bounds.getHeight() * 0.5);
 
     auto lowCutArea = freqAreaBounds.removeFromLeft(bounds.getWidth() * 0.5);
@@ -197,5 +175,87 @@ void EQAudioProcessorEditor::resized()
     peakFreqSlider.setBounds(peakFreqArea4);
     peakGainSlider.setBounds(peakGainArea4);
     peakQualitySlider.setBounds(peakQualityArea4);
-    
+
+    analyzer.setBounds(responseArea.reduced(8));
+    responseCurve.setBounds(responseArea.reduced(8));
+
+    auto statusArea = responseArea.removeFromTop(24);
+    analyzerButton.setBounds(statusArea.removeFromLeft(120).reduced(4, 0));
+    matchButton.setBounds(statusArea.removeFromLeft(120).reduced(4, 1));
+    loadLabel.setBounds(statusArea.removeFromRight(420).reduced(4, 0));
+
+    // the cached background has to be redrawn around the new layout
+    background = {};
+}
+
+void EQAudioProcessorEditor::chooseMatchFiles()
+{
+    auto flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+    auto formats = "*.wav;*.aif;*.aiff;*.flac;*.ogg";
+
+    // two choosers, since a chooser can't be replaced from inside its own callback
+    referenceChooser = std::make_unique<juce::FileChooser>("Choose the reference to match", juce::File(), formats);
+    referenceChooser->launchAsync(flags, [this, flags, formats](const juce::FileChooser& referencePicked)
+    {
+        auto reference = referencePicked.getResult();
+
+        if (reference == juce::File())
+            return;
+
+        materialChooser = std::make_unique<juce::FileChooser>("Choose the material to correct", reference.getParentDirectory(), formats);
+        materialChooser->launchAsync(flags, [this, reference](const juce::FileChooser& materialPicked)
+        {
+            auto material = materialPicked.getResult();
+
+            if (material == juce::File())
+                return;
+
+            audioProcessor.getMatcher().start(reference, material, matchBands, audioProcessor.getChainSettings());
+            updateMatch();
+        });
+    });
+}
+
+void EQAudioProcessorEditor::updateMatch()
+{
+    auto& matcher = audioProcessor.getMatcher();
+
+    switch (matcher.getState())
+    {
+        case SpectralMatch::Matcher::State::running:
+            matchButton.setButtonText(juce::String::formatted("Matching %d%%", juce::roundToInt(matcher.getProgress() * 100.f)));
+            matchButton.setEnabled(false);
+            return;
+
+        // the processor applies the result itself, the knobs follow through their attachments
+        case SpectralMatch::Matcher::State::finished:
+            break;
+
+        case SpectralMatch::Matcher::State::failed:
+            juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Spectral match", matcher.takeError());
+            break;
+
+        case SpectralMatch::Matcher::State::idle:
+            break;
+    }
+
+    matchButton.setButtonText("Match...");
+    matchButton.setEnabled(true);
+}
+
+void EQAudioProcessorEditor::timerCallback()
+{
+    updateMatch();
+
+    auto stats = audioProcessor.getLoadStatistics();
+
+    loadLabel.setText(juce::String::formatted("DSP load  now %.1f%%  avg %.1f%%  worst %.1f%%", stats.current, stats.average, stats.recentWorst), juce::dontSendNotification);
+    loadLabel.setTooltip(juce::String::formatted("coefficients %.2f%%, cascade %.2f%%, dynamic %.2f%%, convolution %.2f%%",
+        stats.stageAverage[DspLoadMeter::coefficientUpdate], stats.stageAverage[DspLoadMeter::cascadeStage],
+        stats.stageAverage[DspLoadMeter::dynamicStage], stats.stageAverage[DspLoadMeter::convolutionStage])
+        + juce::String::formatted("\nworst block since the last reset %.1f%%", stats.worst)
+        + juce::String::formatted("\npaint (avg/worst ms): editor %.2f/%.2f, curve %.2f/%.2f, analyzer %.2f/%.2f",
+        paintStatistics.getAverageMs(), paintStatistics.getWorstMs(),
+        responseCurve.getPaintStatistics().getAverageMs(), responseCurve.getPaintStatistics().getWorstMs(),
+        analyzer.getPaintStatistics().getAverageMs(), analyzer.getPaintStatistics().getWorstMs()));
 }
@@ -8,6 +8,9 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "ResponseCurveComponent.h"
+#include "SpectrumAnalyzerComponent.h"
+#include "PaintStatistics.h"
 
 struct RotarySlider : juce::Slider
 {
@@ -21,7 +24,8 @@ struct RotarySlider : juce::Slider
 //==============================================================================
 /**
 */
-class EQAudioProcessorEditor : public juce::AudioProcessorEditor
+class EQAudioProcessorEditor : public juce::AudioProcessorEditor,
+                                private juce::Timer
 {
 public:
     EQAudioProcessorEditor(EQAudioProcessor&);
@@ -35,6 +39,11 @@ public:
 
 
 private:
+    void timerCallback() override;
+    void renderBackground(float scale);
+    void chooseMatchFiles();
+    void updateMatch();
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     EQAudioProcessor& audioProcessor;
@@ -47,6 +56,23 @@ private:
     RotarySlider lowCutSlopeSlider;
     RotarySlider highCutSlopeSlider;
 
+    SpectrumAnalyzerComponent analyzer{ audioProcessor };
+    ResponseCurveComponent responseCurve{ audioProcessor };
+    juce::ToggleButton analyzerButton{ "Analyzer" };
+
+    // asks for a reference and then the material, the processor's matcher does the rest
+    static constexpr int matchBands = 6;
+    juce::TextButton matchButton{ "Match..." };
+    std::unique_ptr<juce::FileChooser> referenceChooser, materialChooser;
+    juce::Label loadLabel;
+    juce::TooltipWindow tooltipWindow{ this };
+
+    // laid out in resized(), paint() only draws the cached image
+    juce::Rectangle<int> titleArea;
+    juce::Image background;
+    float backgroundScale{ 1.f };
+    PaintStatistics paintStatistics;
+
     juce::AudioProcessorValueTreeState::SliderAttachment highCutSlopeAttachment;
     juce::AudioProcessorValueTreeState::SliderAttachment lowCutSlopeAttachment;
     juce::AudioProcessorValueTreeState::SliderAttachment peakFreqAttachment;
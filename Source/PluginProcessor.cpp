@@ -5,6 +5,24 @@
 */
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+
+namespace
+{
+    template <typename SampleType>
+    bool isSilent(const juce::dsp::AudioBlock<SampleType>& block, SampleType threshold)
+    {
+        for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+        {
+            auto range = juce::FloatVectorOperations::findMinAndMax(block.getChannelPointer(ch), static_cast<int>(block.getNumSamples()));
+
+            if (range.getStart() < -threshold || range.getEnd() > threshold)
+                return false;
+        }
+
+        return true;
+    }
+}
+
 //==============================================================================
 EQAudioProcessor::EQAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -12,15 +30,39 @@ EQAudioProcessor::EQAudioProcessor()
 #if ! JucePlugin_IsMidiEffect
 #if ! JucePlugin_IsSynth
         .withInput("Input", juce::AudioChannelSet::stereo(), true)
+        .withInput("Sidechain", juce::AudioChannelSet::stereo(), false)
 #endif
         .withOutput("Output", juce::AudioChannelSet::stereo(), true)
 #endif
     )
 #endif
 {
+    for (auto* parameter : getParameters())
+        if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter))
+            apvts.addParameterListener(withID->paramID, this);
+
+    // building a kernel takes an FFT, so it happens on the designer thread and only when it's needed
+    designer.onDesigned = [this](const ChainCoefficients& coefficients)
+    {
+        if (isLinearPhase())
+            linearPhase.buildKernel(coefficients);
+
+        // posting a message takes a lock, which the audio thread can't, but this thread can
+        if (latencyChanged.exchange(false))
+            triggerAsyncUpdate();
+    };
+
+    // a finished match is applied on the message thread, whether the editor is open or not
+    matcher.onFinished = [this] { triggerAsyncUpdate(); };
 }
 EQAudioProcessor::~EQAudioProcessor()
 {
+    // the shared thread calls back into this instance's linear phase engine, which goes before the designer does
+    designer.release();
+
+    for (auto* parameter : getParameters())
+        if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter))
+            apvts.removeParameterListener(withID->paramID, this);
 }
 //==============================================================================
 const juce::String EQAudioProcessor::getName() const
@@ -53,177 +95,204 @@ bool EQAudioProcessor::isMidiEffect() const
 }
 double EQAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // hosts use this to decide when they can stop calling processBlock after the input stops, so
+    // it covers everything that can still come out: the latency and the ring of the active filters
+    auto sampleRate = getSampleRate();
+
+    if (isLinearPhase())
+        return sampleRate > 0 ? linearPhase.getTailLengthSamples() / sampleRate : 0.0;
+
+    return (sampleRate > 0 ? getLatencySamples() / sampleRate : 0.0) + designer.getTailLengthSeconds();
 }
 int EQAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return PresetBank::numPresets;
 }
 int EQAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram;
 }
 void EQAudioProcessor::setCurrentProgram(int index)
 {
+    currentProgram = PresetBank::clampIndex(index);
+    applySettings(PresetBank::getSettings(currentProgram), 0);
+}
+
+void EQAudioProcessor::applySettings(const chainsettings& settings, int numBands)
+{
+    auto set = [this](const juce::String& id, float value)
+    {
+        auto* parameter = apvts.getParameter(id);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    };
+
+    // the whole set goes in as one change, so the designer designs it once and the
+    // audio thread can crossfade to exactly that set
+    batchingParameterChanges = true;
+    set("lowcutFreq", settings.lowCutFreq);
+    set("highcutFreq", settings.highCutFreq);
+    set("PeakFreq", settings.peakFreq);
+    set("peakGain", settings.peakGain);
+    set("peakQuality", settings.peakQuality);
+    set("lowcutSlope", static_cast<float>(settings.lowCutSlope));
+    set("highcutSlope", static_cast<float>(settings.highCutSlope));
+
+    // bands that are off keep their knobs where they were
+    for (int i = 0; i < juce::jmin(numBands, maxBands); ++i)
+    {
+        const auto& band = settings.bands[static_cast<size_t>(i)];
+        set(ChainParameters::getBandParameterID(i, "Type"), static_cast<float>(band.type));
+
+        if (band.type == BandOff)
+            continue;
+
+        set(ChainParameters::getBandParameterID(i, "Freq"), band.freq);
+        set(ChainParameters::getBandParameterID(i, "Gain"), band.gain);
+        set(ChainParameters::getBandParameterID(i, "Quality"), band.quality);
+    }
+
+    batchingParameterChanges = false;
+
+    programChangeVersion = parameterVersion.fetch_add(1) + 1;
 }
 const juce::String EQAudioProcessor::getProgramName(int index)
 {
-    return {};
+    return presets.getName(index);
 }
 void EQAudioProcessor::changeProgramName(int index, const juce::String& newName)
 {
+    presets.setName(index, newName);
 }
 //==============================================================================
 void EQAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    // pass a process spec object to both the left and right chain, this will be passed to each link in the chain
-    // this prepares each chain to be prepared for processing 
+    // the designer thread builds linear phase kernels, so this instance is taken off it while things get resized
+    designer.release();
+
+    auto numChannels = getTotalNumOutputChannels();
+    auto numSidechainChannels = getBusCount(true) > 1 ? getChannelCountOfBus(true, 1) : 0;
+
+    // a bus that fits in one SIMD register is a single group, and there's nothing to share out
+    auto lanes = isUsingDoublePrecision() ? juce::dsp::SIMDRegister<double>::size() : juce::dsp::SIMDRegister<float>::size();
+    workerPool.prepare(static_cast<size_t>(numChannels) > lanes ? numWorkerThreads : 0);
+
+    // the host picks the precision before it prepares, so only that path needs any memory
+    if (isUsingDoublePrecision())
+    {
+        doublePath.prepare(numChannels, numSidechainChannels, samplesPerBlock, &workerPool, tileSize);
+        floatPath.release();
+    }
+    else
+    {
+        floatPath.prepare(numChannels, numSidechainChannels, samplesPerBlock, &workerPool, tileSize);
+        doublePath.release();
+    }
+
+    sleeping = false;
+    silentSamples = 0;
 
+    // linear phase mode runs the same response as an FIR kernel through an FFT convolution
     juce::dsp::ProcessSpec shem;
 
-    shem.maximumBlockSize = samplesPerBlock;
+    shem.maximumBlockSize = static_cast<juce::uint32>(samplesPerBlock);
 
-    shem.numChannels = 1;
+    shem.numChannels = static_cast<juce::uint32>(numChannels);
 
     shem.sampleRate = sampleRate;
 
-    leftChain.prepare(shem);
-    rightChain.prepare(shem);
+    linearPhase.prepare(shem);
 
-    auto getchainSettings = getchainsettings(apvts);
+    // its FFT and convolutions only exist while the mode is on
+    if (isLinearPhase())
+        linearPhase.activate();
+    else
+        linearPhase.deactivate();
 
     // IIR or Infinite-Duration Impulse Response Filters uses a feedback mechanism where the previous output,
     //in conjunction with the present and past input,
     //is given as the present input.
 
-    //coefficients for the peak filter:
-
-    auto peakCoefficients = juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate, getchainSettings.peakFreq, getchainSettings.peakQuality, juce::Decibels::decibelsToGain(getchainSettings.peakGain));
-
-    //set the filter's coefficients accordingly:
-    //IIR functions return instances on the heap, rather than in the actual audio buffer.
-    // To access these, you must dereference them
-
-    *leftChain.get<Peak>().coefficients = *peakCoefficients; //the star is used to deref.
-    *rightChain.get<Peak>().coefficients = *peakCoefficients;
+    // the designer works out the first set of coefficients right here, and any later
+    // changes on its own thread, so processBlock only ever copies finished coefficients
+    activeOversamplingFactor = getOversamplingFactor();
+    processingSampleRate = sampleRate * activeOversamplingFactor;
 
+    designer.prepare(processingSampleRate);
+    smoother.prepare(processingSampleRate, parameters.load());
+    loadMeter.prepare(sampleRate);
 
-    // every 2 orders creates an IIRHighPass / LowCut filter
-    // so for x iterations of the filter we need 2x filters
-    //as the first slope choice starts from 0, we need 2x+1 filters
+    if (auto* coefficients = designer.pullLatest())
+        updateFilters(*coefficients);
 
-    auto lowCutCoefficients = juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(getchainSettings.lowCutFreq, sampleRate, (getchainSettings.lowCutSlope + 1) * 2);
+    // a program change made before this has nothing to fade from, the set above already has it
+    handledProgramChangeVersion = programChangeVersion.load();
 
-    auto& RightLowCut = rightChain.get<LowCut>();
-    auto& leftLowCut = leftChain.get<LowCut>();
+    // the host expects the latency to be set here, so there's nothing left to report later
+    latencyChanged = false;
+    cancelPendingUpdate();
+    setLatencySamples(getLatencyForCurrentMode());
+}
 
-    RightLowCut.setBypassed<0>(true);
-    RightLowCut.setBypassed<1>(true);
-    RightLowCut.setBypassed<2>(true);
-    RightLowCut.setBypassed<3>(true);
+bool EQAudioProcessor::waitUntilReadyToRender(int timeoutMs)
+{
+    // this processes silence through the convolutions, which is only safe while nothing else is
+    jassert(isNonRealtime());
 
-    leftLowCut.setBypassed<0>(true);
-    leftLowCut.setBypassed<1>(true);
-    leftLowCut.setBypassed<2>(true);
-    leftLowCut.setBypassed<3>(true);
+    if (!isLinearPhase())
+        return true;
 
-    switch (getchainSettings.lowCutSlope)
-    {
-    case Slope4:
-    {
-        *RightLowCut.get<3>().coefficients = *lowCutCoefficients[3];
-        RightLowCut.setBypassed<3>(false);
-        *leftLowCut.get<3>().coefficients = *lowCutCoefficients[3];
-        leftLowCut.setBypassed<3>(false);
-        [[fallthrough]]; // fallthrough is explicit
-    }
+    return linearPhase.waitForKernel(timeoutMs);
+}
 
-    case Slope3:
-    {
-        *RightLowCut.get<2>().coefficients = *lowCutCoefficients[2];
-        RightLowCut.setBypassed<2>(false);
-        *leftLowCut.get<2>().coefficients = *lowCutCoefficients[2];
-        leftLowCut.setBypassed<2>(false);
-        [[fallthrough]]; // fallthrough is explicit
-    }
-    case Slope2:
-    {
-        *RightLowCut.get<1>().coefficients = *lowCutCoefficients[1];
-        RightLowCut.setBypassed<1>(false);
-        *leftLowCut.get<1>().coefficients = *lowCutCoefficients[1];
-        leftLowCut.setBypassed<1>(false);
-        [[fallthrough]]; // fallthrough is explicit
-    }
-    case Slope1:
-    {
-        *RightLowCut.get<0>().coefficients = *lowCutCoefficients[0];
-        RightLowCut.setBypassed<0>(false);
-        *leftLowCut.get<0>().coefficients = *lowCutCoefficients[0];
-        leftLowCut.setBypassed<0>(false);
-        [[fallthrough]]; // fallthrough is explicit
-    }
-    }
+void EQAudioProcessor::releaseResources()
+{
+    // When playback stops,B you can use this as an opportunity to free up any
+    // spare memory, etc.
+    designer.release();
 
-    auto highCutCoefficients = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(getchainSettings.highCutFreq, sampleRate, (getchainSettings.highCutSlope + 1) * 2);
+    // the engines fall back to running every group themselves without any workers
+    workerPool.release();
+    linearPhase.deactivate();
+}
 
-    auto& RightHighCut = rightChain.get<HighCut>();
-    auto& LeftHighCut = leftChain.get<HighCut>();
+void EQAudioProcessor::updateFilters(const ChainCoefficients& coefficients)
+{
+    // a set designed before the oversampling factor changed is for the wrong rate, the
+    // designer is already working on one for the new rate
+    if (coefficients.sampleRate != processingSampleRate)
+        return;
+
+    // the path that isn't prepared has no cascades, so this only costs anything for the one in use
+    floatPath.setCoefficients(coefficients);
+    doublePath.setCoefficients(coefficients);
+}
 
-    RightHighCut.setBypassed<0>(true);
-    RightHighCut.setBypassed<1>(true);
-    RightHighCut.setBypassed<2>(true);
-    RightHighCut.setBypassed<3>(true);
+void EQAudioProcessor::parameterChanged(const juce::String& parameterID, float)
+{
+    // hosts automate from the audio thread, so this is held to the same rules wherever it's called from
+    RealtimeChecks::ScopedAudioThread realtimeChecks;
 
-    LeftHighCut.setBypassed<0>(true);
-    LeftHighCut.setBypassed<1>(true);
-    LeftHighCut.setBypassed<2>(true);
-    RightHighCut.setBypassed<3>(true);
+    // setStateInformation and setCurrentProgram bump the version once at the end instead
+    if (batchingParameterChanges)
+        return;
 
-    switch (getchainSettings.highCutSlope)
-    {
-    case Slope4:
+    // both of these change the rate the filters run at and the latency. The designer's rate has
+    // to be set before the version moves on, so the redesign it triggers uses the new rate. This
+    // can be the audio thread, so the latency is left for the designer thread to pass on.
+    if (parameterID == "linearPhase" || parameterID == "oversampling")
     {
-
-        *RightHighCut.get<3>().coefficients = *highCutCoefficients[3];
-        RightHighCut.setBypassed<3>(false);
-        *LeftHighCut.get<3>().coefficients = *highCutCoefficients[3];
-        LeftHighCut.setBypassed<3>(false);
-        //[[fallthrough]];
+        updateProcessingRate();
+        latencyChanged = true;
     }
 
-    case Slope3:
-    {
-        *RightHighCut.get<2>().coefficients = *highCutCoefficients[2];
-        RightHighCut.setBypassed<2>(false);
-        *LeftHighCut.get<2>().coefficients = *highCutCoefficients[2];
-        LeftHighCut.setBypassed<2>(false);
-        //[[fallthrough]];
-    }
-    case Slope2:
-    {
-        *RightHighCut.get<1>().coefficients = *highCutCoefficients[1];
-        RightHighCut.setBypassed<1>(false);
-        *LeftHighCut.get<1>().coefficients = *highCutCoefficients[1];
-        LeftHighCut.setBypassed<1>(false);
-        //[[fallthrough]];
-    }
-    case Slope1:
-    {
-        *RightHighCut.get<0>().coefficients = *highCutCoefficients[0];
-        RightHighCut.setBypassed<0>(false);
-        *LeftHighCut.get<0>().coefficients = *highCutCoefficients[0];
-        LeftHighCut.setBypassed<0>(false);
-        //[[fallthrough]];
-    }
-    }
+    parameterVersion.fetch_add(1);
 }
 
-void EQAudioProcessor::releaseResources()
+bool EQAudioProcessor::isLinearPhase() const
 {
-    // When playback stops,B you can use this as an opportunity to free up any
-    // spare memory, etc.
+    return linearPhaseParameter->load() > 0.5f;
 }
+
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool EQAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
@@ -231,24 +300,47 @@ bool EQAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
     juce::ignoreUnused(layouts);
     return true;
 #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // any layout works (mono, stereo, 5.1, 7.1.4, ambisonics...) because the filter
+    // engine is sized from the channel count in prepareToPlay
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
     // This checks if the input layout matches the output layout
 #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
 #endif
+    // the sidechain can be anything, a key with fewer channels than the bus is spread across it
     return true;
 #endif
 }
 #endif
-void EQAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+void EQAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
 {
+    processSamples(buffer);
+}
+
+void EQAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer&)
+{
+    processSamples(buffer);
+}
+
+template <>
+IirPath<float>& EQAudioProcessor::getIirPath<float>() noexcept
+{
+    return floatPath;
+}
+
+template <>
+IirPath<double>& EQAudioProcessor::getIirPath<double>() noexcept
+{
+    return doublePath;
+}
+
+template <typename SampleType>
+void EQAudioProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer)
+{
+    // in a build with EQ_REALTIME_CHECKS any allocation or lock from here on is reported
+    RealtimeChecks::ScopedBlock realtimeChecks;
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -261,137 +353,281 @@ void EQAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::Midi
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    // this code must be implemented in processBlock AS WELL as prepareToPlay
-    // so that the filter can be updated with the new coefficients when the user changes 
-    // the desired frequency. 
+    // every stage is timed for the load meter, the coefficient work and the filtering separately
+    loadMeter.beginBlock(buffer.getNumSamples());
+    auto stageStart = DspLoadMeter::now();
+    juce::int64 coefficientTicks = 0, filterTicks = 0, convolutionTicks = 0;
+    double dynamicShare = 0.0;
 
-    auto getchainSettings = getchainsettings(apvts);
+    // the coefficients are designed on the designer thread whenever a parameter changes,
+    // so a block only has to copy them in when a new set has been handed over
 
-    auto peakCoefficients = juce::dsp::IIR::Coefficients<float>::makePeakFilter(getSampleRate(), getchainSettings.peakFreq, getchainSettings.peakQuality, juce::Decibels::decibelsToGain(getchainSettings.peakGain));
+    auto* designed = designer.pullLatest();
 
-    //A Processerchain needs processing context to be passed through it
-    //in order to run audio via the links in the chain.
-    //Processing contexts needs to be supplied by Audioblock instances. 
+    // a program change waits for its own coefficient set and then crossfades to it. Until then
+    // the smoother is held where it is, so it doesn't start ramping towards the new program.
+    auto pendingProgramChange = programChangeVersion.load();
 
-    *leftChain.get<Peak>().coefficients = *peakCoefficients; //as therse are references, they point to the adresses of variables.
-    *rightChain.get<Peak>().coefficients = *peakCoefficients;// to get the data in these variables, we must dereference them.
+    if (pendingProgramChange != handledProgramChangeVersion)
+    {
+        auto programDesigned = designed != nullptr && static_cast<juce::int32>(designed->version - pendingProgramChange) >= 0;
+
+        // linear phase mode doesn't need any of this, the convolution crossfades to each new kernel
+        if (isLinearPhase() && linearPhase.isActive())
+            handledProgramChangeVersion = pendingProgramChange;
+        else if (programDesigned)
+        {
+            handledProgramChangeVersion = pendingProgramChange;
+
+            if (startProgramCrossfade(*designed))
+                designed = nullptr;
+        }
+    }
 
-    auto lowCutCoefficients = juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(getchainSettings.lowCutFreq, getSampleRate(), (getchainSettings.lowCutSlope + 1) * 2);
+    if (pendingProgramChange == handledProgramChangeVersion)
+        smoother.setTargets(parameters.load());
 
-    auto& RightLowCut = rightChain.get<LowCut>();
+    // only the main bus is filtered, the sidechain channels come after it in the buffer
+    auto block = juce::dsp::AudioBlock<SampleType>(buffer).getSubsetChannelBlock(0, static_cast<size_t>(getMainBusNumOutputChannels()));
+    auto key = getSidechain(buffer);
 
-    RightLowCut.setBypassed<0>(true);
-    RightLowCut.setBypassed<1>(true);
-    RightLowCut.setBypassed<2>(true);
-    RightLowCut.setBypassed<3>(true);
+    // both of these return straight away unless the editor's analyzer is running
+    analyzerInput.push(block);
 
-    auto& leftLowCut = leftChain.get<LowCut>();
+    // anything coming in wakes the filters up again
+    auto inputSilent = isSilent(block, static_cast<SampleType>(silenceThreshold));
+    silentSamples = inputSilent ? silentSamples + static_cast<juce::int64>(block.getNumSamples()) : 0;
+    sleeping = sleeping && inputSilent;
 
-    leftLowCut.setBypassed<0>(true);
-    leftLowCut.setBypassed<1>(true);
-    leftLowCut.setBypassed<2>(true);
-    leftLowCut.setBypassed<3>(true);
-    switch (getchainSettings.lowCutSlope)
-    {
-    case Slope4:
+    if (sleeping)
     {
-        *RightLowCut.get<3>().coefficients = *lowCutCoefficients[3];
-        RightLowCut.setBypassed<3>(false);
-        *leftLowCut.get<3>().coefficients = *lowCutCoefficients[3];
-        leftLowCut.setBypassed<3>(false);
-        //[[fallthrough]];
-    }
+        // the coefficients are still kept up to date, so waking up starts from the right ones.
+        // A program change while asleep has nothing to fade from.
+        if (designed != nullptr)
+            updateFilters(*designed);
 
-    case Slope3:
-    {
-        *RightLowCut.get<2>().coefficients = *lowCutCoefficients[2];
-        RightLowCut.setBypassed<2>(false);
-        *leftLowCut.get<2>().coefficients = *lowCutCoefficients[2];
-        leftLowCut.setBypassed<2>(false);
-        //[[fallthrough]];
+        getIirPath<SampleType>().stopCrossfade();
     }
-    case Slope2:
+    else if (isLinearPhase() && linearPhase.beginBlock())
     {
-        *RightLowCut.get<1>().coefficients = *lowCutCoefficients[1];
-        RightLowCut.setBypassed<1>(false);
-        *leftLowCut.get<1>().coefficients = *lowCutCoefficients[1];
-        leftLowCut.setBypassed<1>(false);
-        //[[fallthrough]];
+        // until the message thread has set the engine up, the IIR cascade carries on at the host rate
+        // the kernel is rebuilt on the designer thread, but the IIR cascade is kept up to date
+        // too so switching back doesn't start from stale coefficients
+        if (designed != nullptr)
+            updateFilters(*designed);
+
+        auto filterStart = DspLoadMeter::now();
+        coefficientTicks += filterStart - stageStart;
+
+        linearPhase.process(block);
+        linearPhase.endBlock();
+        convolutionTicks += DspLoadMeter::now() - filterStart;
     }
-    case Slope1:
+    else
     {
-        *RightLowCut.get<0>().coefficients = *lowCutCoefficients[0];
-        RightLowCut.setBypassed<0>(false);
-        *leftLowCut.get<0>().coefficients = *lowCutCoefficients[0];
-        leftLowCut.setBypassed<0>(false);
-        //[[fallthrough]];
-    }
-    }
+        auto& path = getIirPath<SampleType>();
+        auto factor = getOversamplingFactor();
 
-    auto highCutCoefficients = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(getchainSettings.highCutFreq, getSampleRate(), (getchainSettings.highCutSlope + 1) * 2);
+        if (factor != activeOversamplingFactor)
+            switchOversampling(factor);
 
-    auto& RightHighCut = rightChain.get<HighCut>();
-    auto& LeftHighCut = leftChain.get<HighCut>();
+        // with oversampling on, the whole cascade runs at the higher rate
+        auto iirBlock = block.getSubsetChannelBlock(0, juce::jmin(block.getNumChannels(), static_cast<size_t>(path.getNumChannels())));
+        auto* oversampler = path.getOversampler(factor);
 
-    RightHighCut.setBypassed<0>(true);
-    RightHighCut.setBypassed<1>(true);
-    RightHighCut.setBypassed<2>(true);
-    RightHighCut.setBypassed<3>(true);
+        auto filterStart = DspLoadMeter::now();
+        coefficientTicks += filterStart - stageStart;
 
-    LeftHighCut.setBypassed<0>(true);
-    LeftHighCut.setBypassed<1>(true);
-    LeftHighCut.setBypassed<2>(true);
-    RightHighCut.setBypassed<3>(true);
+        auto processingBlock = oversampler != nullptr ? oversampler->processSamplesUp(iirBlock) : iirBlock;
 
-    switch (getchainSettings.highCutSlope)
-    {
-    case Slope4:
-    {
-        *RightHighCut.get<3>().coefficients = *highCutCoefficients[3];
-        RightHighCut.setBypassed<3>(false);
-        *LeftHighCut.get<3>().coefficients = *highCutCoefficients[3];
-        LeftHighCut.setBypassed<3>(false);
-        //[[fallthrough]];    
-    }
+        // the dynamic peak's detector runs at the oversampled rate too
+        if (oversampler != nullptr && key.getNumChannels() > 0)
+            key = path.holdKey(key, factor);
 
-    case Slope3:
-    {
-        *RightHighCut.get<2>().coefficients = *highCutCoefficients[2];
-        RightHighCut.setBypassed<2>(false);
-        *LeftHighCut.get<2>().coefficients = *highCutCoefficients[2];
-        LeftHighCut.setBypassed<2>(false);
-        //[[fallthrough]];    
+        if (!smoother.isSmoothing())
+        {
+            auto designStart = DspLoadMeter::now();
+
+            if (designed != nullptr)
+                updateFilters(*designed);
+
+            auto chainStart = DspLoadMeter::now();
+            coefficientTicks += chainStart - designStart;
+            filterTicks -= chainStart - designStart;
+
+            path.process(processingBlock, key);
+        }
+        else
+        {
+            // while a parameter is ramping the coefficients are redesigned every control interval,
+            // so the sweep sounds the same whatever buffer size the host uses
+            auto numSamples = processingBlock.getNumSamples();
+            auto controlInterval = static_cast<size_t>(smoother.getControlInterval() * factor);
+
+            for (size_t start = 0; start < numSamples; start += controlInterval)
+            {
+                auto length = juce::jmin(controlInterval, numSamples - start);
+                auto subBlock = processingBlock.getSubBlock(start, length);
+
+                auto designStart = DspLoadMeter::now();
+                updateFilters(smoother.advance(static_cast<int>(length)));
+
+                auto chainStart = DspLoadMeter::now();
+                coefficientTicks += chainStart - designStart;
+                filterTicks -= chainStart - designStart;
+
+                auto subKey = key.getNumChannels() > 0 ? key.getSubBlock(start, length) : key;
+                path.process(subBlock, subKey);
+            }
+        }
+
+        if (oversampler != nullptr)
+            oversampler->processSamplesDown(iirBlock);
+
+        filterTicks += DspLoadMeter::now() - filterStart;
+        dynamicShare = path.takeDynamicShare();
     }
-    case Slope2:
+
+    // the output has to be quiet as well: with latency, the last of the sound can still be on its way
+    if (!sleeping && inputSilent && silentSamples > getLatencySamples() && isSilent(block, static_cast<SampleType>(silenceThreshold)))
+        startSleeping();
+
+    analyzerOutput.push(block);
+
+    loadMeter.addStageTime(DspLoadMeter::coefficientUpdate, coefficientTicks);
+    loadMeter.addStageTime(DspLoadMeter::convolutionStage, convolutionTicks);
+
+    // the dynamic peak is timed inside the engine, and gets its share of the filter time
+    auto dynamicTicks = static_cast<juce::int64>(static_cast<double>(filterTicks) * dynamicShare);
+    loadMeter.addStageTime(DspLoadMeter::dynamicStage, dynamicTicks);
+    loadMeter.addStageTime(DspLoadMeter::cascadeStage, filterTicks - dynamicTicks);
+
+    loadMeter.endBlock();
+}
+
+int EQAudioProcessor::getOversamplingFactor() const
+{
+    // linear phase mode always runs at the host rate
+    if (isLinearPhase())
+        return 1;
+
+    return 1 << juce::jlimit(0, 3, static_cast<int>(oversamplingParameter->load()));
+}
+
+void EQAudioProcessor::switchOversampling(int factor)
+{
+    // audio thread, so nothing here allocates: the oversamplers were all made in prepareToPlay
+    activeOversamplingFactor = factor;
+    processingSampleRate = getSampleRate() * factor;
+
+    floatPath.switchOversampling(factor);
+    doublePath.switchOversampling(factor);
+    smoother.prepare(processingSampleRate, parameters.load());
+    updateFilters(smoother.advance(0));
+}
+
+void EQAudioProcessor::updateProcessingRate()
+{
+    // nothing to do until prepareToPlay has run, it calls this again at the end
+    if (getSampleRate() <= 0)
+        return;
+
+    // the designer has to design for whatever rate the filters will actually run at
+    designer.setSampleRate(getSampleRate() * getOversamplingFactor());
+}
+
+int EQAudioProcessor::getLatencyForCurrentMode() const
+{
+    if (isLinearPhase())
+        return linearPhase.getLatencySamples();
+
+    auto factor = getOversamplingFactor();
+    return isUsingDoublePrecision() ? doublePath.getLatencySamples(factor) : floatPath.getLatencySamples(factor);
+}
+
+void EQAudioProcessor::handleAsyncUpdate()
+{
+    // the match was asked for when it was started, so its result goes straight in
+    if (matcher.getState() == SpectralMatch::Matcher::State::finished)
+        applySettings(matcher.takeResult(), matcher.getNumBands());
+
+    // nothing has been prepared yet, prepareToPlay sets it
+    if (getSampleRate() <= 0)
+        return;
+
+    // the linear phase engine is set up here, off the audio thread, when the mode is switched on,
+    // and freed again when it's switched off. Its first kernel is built straight away, the designer
+    // already designed this change while the engine wasn't there to take it.
+    if (isLinearPhase() && !linearPhase.isActive())
     {
-        *RightHighCut.get<1>().coefficients = *highCutCoefficients[1];
-        RightHighCut.setBypassed<1>(false);
-        *LeftHighCut.get<1>().coefficients = *highCutCoefficients[1];
-        LeftHighCut.setBypassed<1>(false);
-        //[[fallthrough]];    
+        linearPhase.activate();
+        linearPhase.buildKernel(makeChainCoefficients(parameters.load(), getSampleRate()));
     }
-    case Slope1:
+    else if (!isLinearPhase())
     {
-        *RightHighCut.get<0>().coefficients = *highCutCoefficients[0];
-        RightHighCut.setBypassed<0>(false);
-        *LeftHighCut.get<0>().coefficients = *highCutCoefficients[0];
-        LeftHighCut.setBypassed<0>(false);
-        //[[fallthrough]];
-    }
+        linearPhase.deactivate();
     }
 
-    juce::dsp::AudioBlock<float> block(buffer);
+    setLatencySamples(getLatencyForCurrentMode());
+}
+
+template <typename SampleType>
+juce::dsp::AudioBlock<SampleType> EQAudioProcessor::getSidechain(juce::AudioBuffer<SampleType>& buffer) const
+{
+    // an empty block when the host hasn't connected one
+    auto* sidechain = getBus(true, 1);
+
+    if (sidechain == nullptr || !sidechain->isEnabled() || sidechain->getNumberOfChannels() == 0)
+        return {};
+
+    auto firstChannel = getChannelIndexInProcessBlockBuffer(true, 1, 0);
+
+    return juce::dsp::AudioBlock<SampleType>(buffer).getSubsetChannelBlock(static_cast<size_t>(firstChannel),
+                                                                           static_cast<size_t>(sidechain->getNumberOfChannels()));
+}
+
+void EQAudioProcessor::startSleeping()
+{
+    // everything left in the filters is below the threshold by now, so clearing it can't be heard
+    // and the filters start from silence when the input comes back
+    floatPath.reset();
+    doublePath.reset();
+    linearPhase.reset();
+    sleeping = true;
+}
+
+bool EQAudioProcessor::startProgramCrossfade(const ChainCoefficients& coefficients)
+{
+    // if the oversampling factor changed at the same moment the set is for the wrong rate,
+    // the program then just goes in the usual way
+    if (coefficients.sampleRate != processingSampleRate)
+        return false;
+
+    auto length = juce::roundToInt(programCrossfadeSeconds * processingSampleRate);
+    floatPath.startCrossfade(coefficients, length);
+    doublePath.startCrossfade(coefficients, length);
+    updateFilters(coefficients);
 
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    // the new program starts at its own settings instead of ramping there
+    smoother.prepare(processingSampleRate, parameters.load());
+    return true;
+}
 
-    juce::dsp::ProcessContextReplacing<float> leftContextReplacing(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContextReplacing(rightBlock);
+void EQAudioProcessor::resetLoadStatistics()
+{
+    loadMeter.resetStatistics();
+}
 
-    leftChain.process(leftContextReplacing);
-    rightChain.process(rightContextReplacing);
+DspLoadMeter::Statistics EQAudioProcessor::getLoadStatistics()
+{
+    return loadMeter.getStatistics();
+}
 
+void EQAudioProcessor::setSmoothingControlInterval(int numSamples)
+{
+    smoother.setControlInterval(numSamples);
 }
+
 //==============================================================================
 bool EQAudioProcessor::hasEditor() const
 {
@@ -405,14 +641,23 @@ juce::AudioProcessorEditor* EQAudioProcessor::createEditor()
 //==============================================================================
 void EQAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    // a few bytes per parameter, see StateFormat.h
+    StateFormat::write(getParameters(), destData);
 }
 void EQAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    // every parameter that changes would normally bump the version on its own. Holding that
+    // back until they're all in means the designer (and the linear phase kernel) runs once.
+    batchingParameterChanges = true;
+    auto restored = StateFormat::read(data, sizeInBytes, getParameters());
+    batchingParameterChanges = false;
+
+    if (restored)
+    {
+        updateProcessingRate();
+        latencyChanged = true;
+        parameterVersion.fetch_add(1);
+    }
 }
 
 chainsettings getchainsettings(juce::AudioProcessorValueTreeState& apvts)
@@ -430,6 +675,78 @@ chainsettings getchainsettings(juce::AudioProcessorValueTreeState& apvts)
     return settings;
 }
 
+ChainParameters::ChainParameters(juce::AudioProcessorValueTreeState& apvts)
+    : lowCutFreq(apvts.getRawParameterValue("lowcutFreq")),
+    highCutFreq(apvts.getRawParameterValue("highcutFreq")),
+    peakFreq(apvts.getRawParameterValue("PeakFreq")),
+    peakGain(apvts.getRawParameterValue("peakGain")),
+    peakQuality(apvts.getRawParameterValue("peakQuality")),
+    lowCutSlope(apvts.getRawParameterValue("lowcutSlope")),
+    highCutSlope(apvts.getRawParameterValue("highcutSlope")),
+    morph(apvts.getRawParameterValue("morph")),
+    morphTarget(apvts.getRawParameterValue("morphTarget")),
+    dynamicPeak(apvts.getRawParameterValue("dynamicPeak")),
+    dynamicThreshold(apvts.getRawParameterValue("dynamicThreshold")),
+    dynamicRatio(apvts.getRawParameterValue("dynamicRatio")),
+    dynamicAttack(apvts.getRawParameterValue("dynamicAttack")),
+    dynamicRelease(apvts.getRawParameterValue("dynamicRelease")),
+    dynamicSidechain(apvts.getRawParameterValue("dynamicSidechain"))
+{
+    for (int i = 0; i < maxBands; ++i)
+    {
+        auto& band = bands[static_cast<size_t>(i)];
+
+        band.type = apvts.getRawParameterValue(getBandParameterID(i, "Type"));
+        band.freq = apvts.getRawParameterValue(getBandParameterID(i, "Freq"));
+        band.gain = apvts.getRawParameterValue(getBandParameterID(i, "Gain"));
+        band.quality = apvts.getRawParameterValue(getBandParameterID(i, "Quality"));
+    }
+}
+
+juce::String ChainParameters::getBandParameterID(int bandIndex, const char* name)
+{
+    return "band" + juce::String(bandIndex + 1) + name;
+}
+
+chainsettings ChainParameters::load() const
+{
+    chainsettings settings;
+
+    settings.lowCutFreq = lowCutFreq->load();
+    settings.highCutFreq = highCutFreq->load();
+    settings.peakFreq = peakFreq->load();
+    settings.peakGain = peakGain->load();
+    settings.peakQuality = peakQuality->load();
+    settings.lowCutSlope = static_cast<Slope>(lowCutSlope->load());
+    settings.highCutSlope = static_cast<Slope>(highCutSlope->load());
+
+    settings.dynamicPeak = dynamicPeak->load() > 0.5f;
+    settings.dynamicThreshold = dynamicThreshold->load();
+    settings.dynamicRatio = dynamicRatio->load();
+    settings.dynamicAttack = dynamicAttack->load();
+    settings.dynamicRelease = dynamicRelease->load();
+    settings.dynamicSidechain = dynamicSidechain->load() > 0.5f;
+
+    for (size_t i = 0; i < bands.size(); ++i)
+    {
+        auto& band = settings.bands[i];
+
+        band.type = static_cast<BandType>(bands[i].type->load());
+        band.freq = bands[i].freq->load();
+        band.gain = bands[i].gain->load();
+        band.quality = bands[i].quality->load();
+    }
+
+    // the designer and the smoother both get their settings from here, so the morph is
+    // designed on the designer thread and ramped at the control rate like any other change
+    auto morphAmount = morph->load();
+
+    if (morphAmount > 0.f)
+        settings = interpolate(settings, PresetBank::getSettings(static_cast<int>(morphTarget->load())), morphAmount);
+
+    return settings;
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout EQAudioProcessor::createParameterLayout()
 {
     juce::AudioProcessorValueTreeState::ParameterLayout layout;
@@ -467,6 +784,46 @@ juce::AudioProcessorValueTreeState::ParameterLayout EQAudioProcessor::createPara
     layout.add(std::make_unique<juce::AudioParameterChoice>("lowcutSlope", "LowCut Slope", stringArray, 0));
     layout.add(std::make_unique<juce::AudioParameterChoice>("highcutSlope", "HighCut Slope", stringArray, 0));
 
+    //Oversampling (keeps the high cut and peak close to their analog shape near Nyquist)
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>("oversampling", "Oversampling", juce::StringArray{ "Off", "2x", "4x", "8x" }, 0));
+
+    //Morph (blends the knobs towards one of the presets)
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("morph", "Morph", juce::NormalisableRange<float>(0.f, 1.f, 0.001f, 1.f), 0.f));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("morphTarget", "Morph Target", PresetBank::getFactoryNames(), 0));
+
+    //Dynamic Peak (the peak only moves towards its gain while the level in the band is over the threshold)
+
+    layout.add(std::make_unique<juce::AudioParameterBool>("dynamicPeak", "Dynamic Peak", false));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("dynamicThreshold", "Dynamic Threshold", juce::NormalisableRange<float>(-60.f, 0.f, 0.1f, 1.f), -24.f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("dynamicRatio", "Dynamic Ratio", juce::NormalisableRange<float>(1.f, 20.f, 0.1f, 0.5f), 2.f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("dynamicAttack", "Dynamic Attack", juce::NormalisableRange<float>(0.1f, 200.f, 0.1f, 0.3f), 10.f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("dynamicRelease", "Dynamic Release", juce::NormalisableRange<float>(5.f, 2000.f, 1.f, 0.3f), 100.f));
+    layout.add(std::make_unique<juce::AudioParameterBool>("dynamicSidechain", "Dynamic Sidechain", false));
+
+    //Extra Bands (all off to begin with, spread over the spectrum so each one starts somewhere useful)
+
+    juce::StringArray bandTypes{ "Off", "Peak", "Low Shelf", "High Shelf", "Notch", "Band Pass", "Low Cut", "High Cut" };
+
+    for (int i = 0; i < maxBands; ++i)
+    {
+        auto name = "Band " + juce::String(i + 1);
+        auto defaultFreq = static_cast<float>(juce::roundToInt(30.0 * std::pow(16000.0 / 30.0, i / static_cast<double>(maxBands - 1))));
+
+        auto group = std::make_unique<juce::AudioProcessorParameterGroup>("band" + juce::String(i + 1), name, "|");
+        group->addChild(std::make_unique<juce::AudioParameterChoice>(ChainParameters::getBandParameterID(i, "Type"), name + " Type", bandTypes, 0));
+        group->addChild(std::make_unique<juce::AudioParameterFloat>(ChainParameters::getBandParameterID(i, "Freq"), name + " Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), defaultFreq));
+        group->addChild(std::make_unique<juce::AudioParameterFloat>(ChainParameters::getBandParameterID(i, "Gain"), name + " Gain", juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f), 0.f));
+        group->addChild(std::make_unique<juce::AudioParameterFloat>(ChainParameters::getBandParameterID(i, "Quality"), name + " Quality", juce::NormalisableRange<float>(0.1f, 10.f, 0.01f, 1.f), 0.71f));
+
+        layout.add(std::move(group));
+    }
+
+    //Linear Phase (same response as an FIR kernel, at the cost of latency)
+
+    layout.add(std::make_unique<juce::AudioParameterBool>("linearPhase", "Linear Phase", false));
+
     return layout;
 }
 //==============================================================================
@@ -6,36 +6,71 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ChainSettings.h"
+#include "CoefficientDesigner.h"
+#include "DspLoadMeter.h"
+#include "IirPath.h"
+#include "LinearPhaseEngine.h"
+#include "ParameterSmoother.h"
+#include "PresetBank.h"
+#include "RealtimeChecks.h"
+#include "SampleFifo.h"
+#include "SpectralMatch.h"
+#include "StateFormat.h"
+#include "WorkerPool.h"
 
-const std::integral_constant<int, 0> LowCut;
-const std::integral_constant<int, 1> Peak;
-const std::integral_constant<int, 2> HighCut;
-
-enum Slope
-{
-    Slope1,
-    Slope2,
-    Slope3,
-    Slope4
-};
-
+chainsettings getchainsettings(juce::AudioProcessorValueTreeState& apvts);
 
-//creating a structure so that the apvts can pull these values every time it is called, rather than having to write them out over and over.
-struct chainsettings
+// the raw parameter pointers are looked up once, so reading the settings doesn't need seven string lookups every time
+struct ChainParameters
 {
-    float peakFreq{ 0 }, peakGain{ 0 }, peakQuality{ 1.f };
-    float lowCutFreq{ 0 }, highCutFreq{ 0 };
-    Slope lowCutSlope{ Slope::Slope1 }, highCutSlope{ Slope::Slope1 };
+    explicit ChainParameters(juce::AudioProcessorValueTreeState& apvts);
+
+    chainsettings load() const;
+
+    std::atomic<float>* lowCutFreq;
+    std::atomic<float>* highCutFreq;
+    std::atomic<float>* peakFreq;
+    std::atomic<float>* peakGain;
+    std::atomic<float>* peakQuality;
+    std::atomic<float>* lowCutSlope;
+    std::atomic<float>* highCutSlope;
+
+    // blends the knobs towards one of the presets, see interpolate()
+    std::atomic<float>* morph;
+    std::atomic<float>* morphTarget;
+
+    // the peak's dynamic mode, see DynamicBand
+    std::atomic<float>* dynamicPeak;
+    std::atomic<float>* dynamicThreshold;
+    std::atomic<float>* dynamicRatio;
+    std::atomic<float>* dynamicAttack;
+    std::atomic<float>* dynamicRelease;
+    std::atomic<float>* dynamicSidechain;
+
+    // the extra bands, a type of Off leaves a band out of the cascade altogether
+    struct BandParameters
+    {
+        std::atomic<float>* type;
+        std::atomic<float>* freq;
+        std::atomic<float>* gain;
+        std::atomic<float>* quality;
+    };
+
+    std::array<BandParameters, maxBands> bands;
+
+    // "band1Type", "band12Freq" and so on, bands count from 1
+    static juce::String getBandParameterID(int bandIndex, const char* name);
 };
 
-chainsettings getchainsettings(juce::AudioProcessorValueTreeState& apvts);
-
 
 
 //==============================================================================
 /**
 */
-class EQAudioProcessor : public juce::AudioProcessor
+class EQAudioProcessor : public juce::AudioProcessor,
+                         private juce::AudioProcessorValueTreeState::Listener,
+                         private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -48,6 +83,10 @@ public:
     bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
 #endif
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    // hosts with a 64-bit mix bus get a chain that runs in double all the way through
+    bool supportsDoublePrecisionProcessing() const override { return true; }
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -67,21 +106,132 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    // while parameters ramp the coefficients are redesigned every numSamples (16 or 32 is a good choice)
+    void setSmoothingControlInterval(int numSamples);
+
+    // off (0) by default. With a few worker threads a bus wider than one SIMD register has its
+    // channel groups filtered in parallel once the blocks are big enough to be worth it.
+    // Takes effect at the next prepareToPlay. This is for offline use and the tools only, it isn't
+    // a parameter: a plugin starting realtime threads of its own competes with the host's.
+    void setNumWorkerThreads(int numThreads) { numWorkerThreads = juce::jmax(0, numThreads); }
+
+    // blocks longer than this (at the oversampled rate) go through the cascade in tiles of this
+    // many samples, so each tile stays in L1 from the first stage to the last. 0, the default,
+    // picks a size from the cache and the SIMD width. Takes effect at the next prepareToPlay.
+    void setTileSize(int numSamples) { tileSize = juce::jmax(0, numSamples); }
+
+    // for offline renders, after prepareToPlay and before the first block: waits until whatever
+    // prepareToPlay left loading in the background (the linear phase kernel) is in place, so
+    // the first block already has it. False if that took longer than timeoutMs.
+    bool waitUntilReadyToRender(int timeoutMs);
+
+    // sets the cuts, the peak and the first numBands extra bands from settings as one change,
+    // which crossfades like a program change. Message thread only.
+    void applySettings(const chainsettings& settings, int numBands);
+
+    // the editor's spectral match runs here rather than in the editor, so closing the editor
+    // doesn't throw away an analysis that's half done. The processor applies the result as soon
+    // as it's finished, the editor only starts it and shows how far it's got.
+    SpectralMatch::Matcher& getMatcher() noexcept { return matcher; }
+
+    // current, average and worst block time as a percentage of the real-time budget, plus the
+    // average of each stage. Safe to call from any thread except the audio thread, and so is
+    // the reset, which starts the worst block and the averages again. It's there for monitoring,
+    // nothing in the plugin calls it apart from prepareToPlay.
+    DspLoadMeter::Statistics getLoadStatistics();
+    void resetLoadStatistics();
+
+    // for the editor's response curve, all safe to call from any thread. The version moves on
+    // whenever any parameter changes, so a reader only needs to redraw when it differs.
+    chainsettings getChainSettings() const { return parameters.load(); }
+    juce::uint32 getParameterVersion() const noexcept { return parameterVersion.load(); }
+    double getDesignSampleRate() const noexcept { return designer.getSampleRate(); }
+    int getNumCoefficientDesigns() const noexcept { return designer.getNumDesigns(); }
+
+    // the input and output of every block, mixed to mono, for the editor's spectrum analyzer.
+    // Only written while the analyzer has switched them on.
+    SampleFifo analyzerInput, analyzerOutput;
+
     juce::AudioProcessorValueTreeState apvts{ *this, nullptr, "Parameters", createParameterLayout() };
 
     //slope of cut filters are multiples of 12dB/Oct and filters defaults at 12dB/Oct, but we want up to 48 dB/Oct
 
 private:
-    using Filter = juce::dsp::IIR::Filter<float>;
-
-    using VariableCut = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>; // 12 dB/Oct * 4 = 48dB/Oct
-
-    using SingleChain = juce::dsp::ProcessorChain<VariableCut, Filter, VariableCut>;
-    //dsp defaults as mono instead of stereo, so creating a left and right channel
-    //to play concurrently will result in stereo sound
-
-    SingleChain leftChain, rightChain;
-
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    bool isLinearPhase() const;
+    int getOversamplingFactor() const;
+    void switchOversampling(int factor);
+    void updateProcessingRate();
+    int getLatencyForCurrentMode() const;
+
+    // reports a new latency to the host and applies a finished spectral match, on the message thread
+    void handleAsyncUpdate() override;
+
+    ChainParameters parameters{ apvts };
+    std::atomic<float>* linearPhaseParameter{ apvts.getRawParameterValue("linearPhase") };
+    std::atomic<float>* oversamplingParameter{ apvts.getRawParameterValue("oversampling") };
+
+    // bumped whenever any parameter moves, the designer thread redesigns when it sees a new value
+    std::atomic<juce::uint32> parameterVersion{ 0 };
+
+    // set while a state restore or a program change sets many parameters at once, so
+    // they're designed once at the end rather than once per parameter
+    std::atomic<bool> batchingParameterChanges{ false };
+
+    // set when linear phase or oversampling changes. parameterChanged is usually on the audio thread,
+    // so the designer thread passes it on to the message thread, which tells the host.
+    std::atomic<bool> latencyChanged{ false };
+    CoefficientDesigner designer{ [this] { return parameters.load(); }, parameterVersion };
+    ParameterSmoother smoother;
+
+    // the cascade, the oversamplers around it and the program crossfade, at each precision.
+    // Only the one the host is using is prepared.
+    IirPath<float> floatPath;
+    IirPath<double> doublePath;
+
+    // only started when there are channel groups to share out, see setNumWorkerThreads
+    WorkerPool workerPool;
+    int numWorkerThreads{ 0 };
+    int tileSize{ 0 };
+
+    // a program change swaps in the spare engine with the new program's coefficients, and
+    // the old one keeps running on a copy of the input while it's faded out
+    static constexpr double programCrossfadeSeconds = 0.05;
+    PresetBank presets;
+    int currentProgram{ 0 };
+    std::atomic<juce::uint32> programChangeVersion{ 0 };
+    juce::uint32 handledProgramChangeVersion{ 0 };
+
+    LinearPhaseEngine linearPhase;
+    SpectralMatch::Matcher matcher;
+
+    // 2x, 4x and 8x oversampling around the IIR cascade
+    int activeOversamplingFactor{ 1 };
+    double processingSampleRate{ 44100.0 };
+
+    // once the input has been silent for longer than the latency and what the filters still
+    // had in them has died away below silenceThreshold, the filtering stops until the input comes back
+    static constexpr float silenceThreshold = 1.0e-5f; // -100 dB
+    bool sleeping{ false };
+    juce::int64 silentSamples{ 0 };
+
+    DspLoadMeter loadMeter;
+
+    void updateFilters(const ChainCoefficients& coefficients);
+
+    // both processBlocks run this, with SampleType float or double
+    template <typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer);
+
+    template <typename SampleType>
+    IirPath<SampleType>& getIirPath() noexcept;
+
+    template <typename SampleType>
+    juce::dsp::AudioBlock<SampleType> getSidechain(juce::AudioBuffer<SampleType>& buffer) const;
+
+    bool startProgramCrossfade(const ChainCoefficients& coefficients);
+    void startSleeping();
 
 
     //==============================================================================
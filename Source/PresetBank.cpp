@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+    The plugin's programs. Each program is a complete set of chain settings.
+    The settings are fixed at compile time, so the designer and audio threads
+    can read them without locking. Only the names can be changed, and only
+    from the message thread.
+  ==============================================================================
+*/
+#include "PresetBank.h"
+
+namespace
+{
+    struct FactoryPreset
+    {
+        const char* name;
+        chainsettings settings;
+    };
+
+    chainsettings makeSettings(float lowCutFreq, Slope lowCutSlope, float peakFreq, float peakGain, float peakQuality,
+                               float highCutFreq, Slope highCutSlope)
+    {
+        chainsettings settings;
+        settings.lowCutFreq = lowCutFreq;
+        settings.lowCutSlope = lowCutSlope;
+        settings.peakFreq = peakFreq;
+        settings.peakGain = peakGain;
+        settings.peakQuality = peakQuality;
+        settings.highCutFreq = highCutFreq;
+        settings.highCutSlope = highCutSlope;
+        return settings;
+    }
+
+    // the first one matches the parameter defaults
+    const std::array<FactoryPreset, PresetBank::numPresets>& getFactoryPresets()
+    {
+        static const std::array<FactoryPreset, PresetBank::numPresets> presets
+        { {
+            { "Flat",           makeSettings(20.f,  Slope1, 750.f,   0.f,  1.f,   20000.f, Slope1) },
+            { "Rumble Filter",  makeSettings(80.f,  Slope4, 750.f,   0.f,  1.f,   20000.f, Slope1) },
+            { "Vocal Presence", makeSettings(100.f, Slope2, 3000.f,  4.f,  0.8f,  18000.f, Slope1) },
+            { "Air",            makeSettings(30.f,  Slope1, 12000.f, 5.f,  0.5f,  20000.f, Slope1) },
+            { "Warmth",         makeSettings(30.f,  Slope1, 250.f,   3.f,  0.7f,  12000.f, Slope1) },
+            { "Mud Cut",        makeSettings(40.f,  Slope2, 350.f,  -6.f,  1.4f,  20000.f, Slope1) },
+            { "Telephone",      makeSettings(400.f, Slope4, 1500.f,  6.f,  1.f,   3400.f,  Slope4) },
+            { "De-Harsh",       makeSettings(20.f,  Slope1, 3500.f, -4.f,  2.f,   16000.f, Slope2) },
+        } };
+
+        return presets;
+    }
+}
+
+PresetBank::PresetBank()
+{
+    for (int i = 0; i < numPresets; ++i)
+        names[static_cast<size_t>(i)] = getFactoryPresets()[static_cast<size_t>(i)].name;
+}
+
+const chainsettings& PresetBank::getSettings(int index)
+{
+    return getFactoryPresets()[static_cast<size_t>(clampIndex(index))].settings;
+}
+
+juce::StringArray PresetBank::getFactoryNames()
+{
+    juce::StringArray result;
+
+    for (auto& preset : getFactoryPresets())
+        result.add(preset.name);
+
+    return result;
+}
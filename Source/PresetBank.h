@@ -0,0 +1,33 @@
+/*
+  ==============================================================================
+    The plugin's programs. Each program is a complete set of chain settings.
+    The settings are fixed at compile time, so the designer and audio threads
+    can read them without locking. Only the names can be changed, and only
+    from the message thread.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChainSettings.h"
+
+class PresetBank
+{
+public:
+    static constexpr int numPresets = 8;
+
+    PresetBank();
+
+    // any thread
+    static const chainsettings& getSettings(int index);
+    static juce::StringArray getFactoryNames();
+
+    // message thread
+    const juce::String& getName(int index) const { return names[static_cast<size_t>(clampIndex(index))]; }
+    void setName(int index, const juce::String& newName) { names[static_cast<size_t>(clampIndex(index))] = newName; }
+
+    static int clampIndex(int index) noexcept { return juce::jlimit(0, numPresets - 1, index); }
+
+private:
+    std::array<juce::String, numPresets> names;
+};
@@ -0,0 +1,379 @@
+/*
+  ==============================================================================
+    Catches allocations and locks on the audio thread, see RealtimeChecks.h.
+    Everything in here is compiled out unless EQ_REALTIME_CHECKS is 1.
+  ==============================================================================
+*/
+#include "RealtimeChecks.h"
+
+#if EQ_REALTIME_CHECKS
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+ #include <dbghelp.h>
+ #pragma comment(lib, "dbghelp.lib")
+#else
+ #include <execinfo.h>
+#endif
+
+#if JUCE_LINUX
+ #include <cerrno>
+ #include <dlfcn.h>
+ #include <pthread.h>
+
+// glibc's own entry points, so the replacements below can hand the real work on
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+}
+#endif
+
+namespace
+{
+    using RealtimeChecks::Kind;
+    using RealtimeChecks::Violation;
+
+    // plain bools so reading them from inside malloc never needs anything set up first
+    thread_local bool onAudioThread = false;
+
+    // capturing the stack can allocate, and that mustn't count again
+    thread_local bool reporting = false;
+
+    std::array<Violation, RealtimeChecks::maxRecordedViolations> recorded;
+    std::atomic<int> numRecorded{ 0 };
+
+    std::atomic<juce::int64> numBlocks{ 0 }, numViolations{ 0 }, blocksWithViolations{ 0 };
+    std::array<std::atomic<juce::int64>, 3> numByKind{};
+    std::atomic<int> blockViolations{ 0 }, worstBlockViolations{ 0 };
+
+    // the interceptors allocate through these so a single new isn't reported twice
+    void* allocateUnchecked(std::size_t size) noexcept
+    {
+       #if JUCE_LINUX
+        return __libc_malloc(size);
+       #else
+        return std::malloc(size);
+       #endif
+    }
+
+    void freeUnchecked(void* ptr) noexcept
+    {
+       #if JUCE_LINUX
+        __libc_free(ptr);
+       #else
+        std::free(ptr);
+       #endif
+    }
+
+    void* allocateAlignedUnchecked(std::size_t size, std::size_t alignment) noexcept
+    {
+       #if JUCE_LINUX
+        return __libc_memalign(alignment, size);
+       #elif JUCE_WINDOWS
+        return _aligned_malloc(size, alignment);
+       #else
+        void* ptr = nullptr;
+        return posix_memalign(&ptr, juce::jmax(alignment, sizeof(void*)), size) == 0 ? ptr : nullptr;
+       #endif
+    }
+
+    void freeAlignedUnchecked(void* ptr) noexcept
+    {
+       #if JUCE_WINDOWS
+        _aligned_free(ptr);
+       #else
+        freeUnchecked(ptr);
+       #endif
+    }
+
+    void* checkedAllocateAligned(std::size_t size, std::align_val_t alignment)
+    {
+        RealtimeChecks::report(Kind::allocation);
+
+        if (auto* ptr = allocateAlignedUnchecked(size == 0 ? 1 : size, static_cast<std::size_t>(alignment)))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    void checkedFreeAligned(void* ptr) noexcept
+    {
+        if (ptr != nullptr)
+            RealtimeChecks::report(Kind::deallocation);
+
+        freeAlignedUnchecked(ptr);
+    }
+
+    void* checkedAllocate(std::size_t size)
+    {
+        RealtimeChecks::report(Kind::allocation);
+
+        if (auto* ptr = allocateUnchecked(size == 0 ? 1 : size))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    void checkedFree(void* ptr) noexcept
+    {
+        if (ptr != nullptr)
+            RealtimeChecks::report(Kind::deallocation);
+
+        freeUnchecked(ptr);
+    }
+
+    void captureStack(Violation& violation) noexcept
+    {
+       #if JUCE_WINDOWS
+        violation.numFrames = static_cast<int>(CaptureStackBackTrace(0, Violation::maxFrames, violation.frames, nullptr));
+       #else
+        violation.numFrames = backtrace(violation.frames, Violation::maxFrames);
+       #endif
+    }
+
+    // the top few frames are the checks themselves and the interceptor, the caller is below those
+    void describeStack(const Violation& violation, juce::String& description)
+    {
+       #if JUCE_WINDOWS
+        auto process = GetCurrentProcess();
+        static const bool symbolsLoaded = SymInitialize(process, nullptr, TRUE) != FALSE;
+
+        if (!symbolsLoaded)
+            return;
+
+        alignas(SYMBOL_INFO) char storage[sizeof(SYMBOL_INFO) + 256]{};
+        auto* symbol = reinterpret_cast<SYMBOL_INFO*>(storage);
+        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+        symbol->MaxNameLen = 255;
+
+        for (int frame = 0; frame < violation.numFrames; ++frame)
+        {
+            auto address = reinterpret_cast<DWORD64>(violation.frames[frame]);
+
+            if (SymFromAddr(process, address, nullptr, symbol))
+                description << "    " << juce::String(symbol->Name) << juce::newLine;
+            else
+                description << "    0x" << juce::String::toHexString(static_cast<juce::int64>(address)) << juce::newLine;
+        }
+       #else
+        if (auto* symbols = backtrace_symbols(violation.frames, violation.numFrames))
+        {
+            for (int frame = 0; frame < violation.numFrames; ++frame)
+                description << "    " << symbols[frame] << juce::newLine;
+
+            std::free(symbols);
+        }
+       #endif
+    }
+
+    const char* getName(Kind kind) noexcept
+    {
+        switch (kind)
+        {
+            case Kind::allocation:   return "allocation";
+            case Kind::deallocation: return "deallocation";
+            case Kind::lock:         return "lock";
+        }
+
+        return "";
+    }
+}
+
+//==============================================================================
+RealtimeChecks::ScopedAudioThread::ScopedAudioThread() noexcept
+    : wasAudioThread(onAudioThread)
+{
+    onAudioThread = true;
+}
+
+RealtimeChecks::ScopedAudioThread::~ScopedAudioThread()
+{
+    onAudioThread = wasAudioThread;
+}
+
+RealtimeChecks::ScopedBlock::ScopedBlock() noexcept
+{
+}
+
+RealtimeChecks::ScopedBlock::~ScopedBlock()
+{
+    // only the audio thread writes the block counts, the workers only add to blockViolations.
+    // Anything since the last block counts towards this one, which covers the parameter
+    // changes a host makes on the audio thread just before it calls processBlock.
+    auto inThisBlock = blockViolations.exchange(0);
+
+    if (inThisBlock > 0)
+    {
+        ++blocksWithViolations;
+        worstBlockViolations.store(juce::jmax(worstBlockViolations.load(), inThisBlock));
+    }
+
+    ++numBlocks;
+}
+
+bool RealtimeChecks::isAudioThread() noexcept
+{
+    return onAudioThread;
+}
+
+void RealtimeChecks::report(Kind kind) noexcept
+{
+    if (!onAudioThread || reporting)
+        return;
+
+    reporting = true;
+    ++numViolations;
+    ++numByKind[static_cast<size_t>(kind)];
+    ++blockViolations;
+
+    auto index = numRecorded.fetch_add(1);
+
+    if (index < maxRecordedViolations)
+    {
+        auto& violation = recorded[static_cast<size_t>(index)];
+        violation.kind = kind;
+        violation.block = numBlocks.load();
+        captureStack(violation);
+    }
+
+    reporting = false;
+}
+
+RealtimeChecks::Summary RealtimeChecks::getSummary() noexcept
+{
+    Summary summary;
+    summary.numBlocks = numBlocks.load();
+    summary.numViolations = numViolations.load();
+    summary.blocksWithViolations = blocksWithViolations.load();
+    summary.worstBlockViolations = worstBlockViolations.load();
+    summary.numAllocations = numByKind[static_cast<size_t>(Kind::allocation)].load();
+    summary.numDeallocations = numByKind[static_cast<size_t>(Kind::deallocation)].load();
+    summary.numLocks = numByKind[static_cast<size_t>(Kind::lock)].load();
+    return summary;
+}
+
+juce::String RealtimeChecks::describeViolations()
+{
+    jassert(!onAudioThread);
+
+    juce::String description;
+    auto numToDescribe = juce::jmin(numRecorded.load(), maxRecordedViolations);
+
+    for (int i = 0; i < numToDescribe; ++i)
+    {
+        auto& violation = recorded[static_cast<size_t>(i)];
+        description << getName(violation.kind) << " in block " << violation.block << juce::newLine;
+        describeStack(violation, description);
+    }
+
+    if (numViolations.load() > numToDescribe)
+        description << "(" << (numViolations.load() - numToDescribe) << " more without stacks)" << juce::newLine;
+
+    return description;
+}
+
+void RealtimeChecks::resetCounts() noexcept
+{
+    numRecorded.store(0);
+    numBlocks.store(0);
+    blockViolations.store(0);
+    numViolations.store(0);
+    blocksWithViolations.store(0);
+    worstBlockViolations.store(0);
+
+    for (auto& count : numByKind)
+        count.store(0);
+}
+
+//==============================================================================
+// replacing these applies to everything linked into the binary
+void* operator new(std::size_t size) { return checkedAllocate(size); }
+void* operator new[](std::size_t size) { return checkedAllocate(size); }
+void operator delete(void* ptr) noexcept { checkedFree(ptr); }
+void operator delete[](void* ptr) noexcept { checkedFree(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { checkedFree(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { checkedFree(ptr); }
+
+// over-aligned types (SIMD registers, alignas(64) members) come through these instead
+void* operator new(std::size_t size, std::align_val_t alignment) { return checkedAllocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return checkedAllocateAligned(size, alignment); }
+void operator delete(void* ptr, std::align_val_t) noexcept { checkedFreeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { checkedFreeAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { checkedFreeAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { checkedFreeAligned(ptr); }
+
+#if JUCE_LINUX
+// glibc lets the executable replace malloc and friends outright, which also catches C code,
+// HeapBlock and AudioBuffer. Other platforms only see operator new and delete, and
+// locks are only caught here too: std::mutex and CriticalSection don't go through anything that
+// can be replaced on Windows or macOS.
+extern "C"
+{
+    void* malloc(size_t size)
+    {
+        RealtimeChecks::report(Kind::allocation);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        RealtimeChecks::report(Kind::allocation);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        RealtimeChecks::report(Kind::allocation);
+        return __libc_realloc(ptr, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        RealtimeChecks::report(Kind::allocation);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size)
+    {
+        RealtimeChecks::report(Kind::allocation);
+        *result = __libc_memalign(alignment, size);
+        return *result != nullptr ? 0 : ENOMEM;
+    }
+
+    void free(void* ptr)
+    {
+        if (ptr != nullptr)
+            RealtimeChecks::report(Kind::deallocation);
+
+        __libc_free(ptr);
+    }
+
+    // std::mutex and juce::CriticalSection both end up here. The real function is looked up on
+    // first use, through an atomic rather than a static so no guard lock is involved.
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        using LockFunction = int (*)(pthread_mutex_t*);
+        static std::atomic<LockFunction> realLock{ nullptr };
+
+        auto lock = realLock.load();
+
+        if (lock == nullptr)
+        {
+            lock = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+            realLock.store(lock);
+        }
+
+        RealtimeChecks::report(Kind::lock);
+        return lock(mutex);
+    }
+}
+#endif
+
+#endif
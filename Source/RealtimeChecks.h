@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+    Catches allocations and locks on the audio thread. Only compiled in when
+    EQ_REALTIME_CHECKS is 1, which replaces the global operator new/delete
+    (and, on Linux, malloc, free and pthread_mutex_lock) for the whole binary,
+    so it's meant for test builds like Tools/RealtimeCheck and Tools/Benchmark
+    rather than the plugin. With it off the scopes below are empty and cost nothing.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef EQ_REALTIME_CHECKS
+ #define EQ_REALTIME_CHECKS 0
+#endif
+
+namespace RealtimeChecks
+{
+    enum class Kind
+    {
+        allocation,
+        deallocation,
+        lock
+    };
+
+    // whatever happened, in which block, and the call stack that did it
+    struct Violation
+    {
+        static constexpr int maxFrames = 32;
+
+        Kind kind{ Kind::allocation };
+        juce::int64 block{ 0 };
+        int numFrames{ 0 };
+        void* frames[maxFrames]{};
+    };
+
+    // only the first few are kept with their stacks, the counts below include all of them
+    static constexpr int maxRecordedViolations = 64;
+
+    struct Summary
+    {
+        juce::int64 numBlocks{ 0 }, numViolations{ 0 }, blocksWithViolations{ 0 };
+        int worstBlockViolations{ 0 };
+
+        // numViolations split up by Kind
+        juce::int64 numAllocations{ 0 }, numDeallocations{ 0 }, numLocks{ 0 };
+    };
+
+   #if EQ_REALTIME_CHECKS
+    // marks the calling thread as one that must not allocate or lock while the scope is alive.
+    // The worker pool's threads use this while they're running audio work.
+    class ScopedAudioThread
+    {
+    public:
+        ScopedAudioThread() noexcept;
+        ~ScopedAudioThread();
+
+    private:
+        bool wasAudioThread;
+    };
+
+    // one processBlock: tags the thread and counts the violations in the block, along with any
+    // from a ScopedAudioThread on the same thread since the last block
+    class ScopedBlock
+    {
+    public:
+        ScopedBlock() noexcept;
+        ~ScopedBlock();
+
+    private:
+        ScopedAudioThread audioThread;
+    };
+
+    // called by the interceptors, only does anything on a tagged thread
+    void report(Kind kind) noexcept;
+    bool isAudioThread() noexcept;
+
+    // not from the audio thread: reading the stacks back allocates
+    Summary getSummary() noexcept;
+    juce::String describeViolations();
+    void resetCounts() noexcept;
+   #else
+    struct ScopedAudioThread { ScopedAudioThread() noexcept {} };
+    struct ScopedBlock { ScopedBlock() noexcept {} };
+
+    inline void report(Kind) noexcept {}
+    inline bool isAudioThread() noexcept { return false; }
+
+    inline Summary getSummary() noexcept { return {}; }
+    inline juce::String describeViolations() { return {}; }
+    inline void resetCounts() noexcept {}
+   #endif
+}
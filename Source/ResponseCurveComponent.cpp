@@ -0,0 +1,149 @@
+/*
+  ==============================================================================
+    Draws the combined magnitude response of the low cut, peak and high cut
+    in the editor's response area. The curve is worked out on a background
+    thread, one point per pixel column, and only when the processor's
+    parameter version has moved on, so paint() just strokes a cached path.
+  ==============================================================================
+*/
+#include "ResponseCurveComponent.h"
+#include "CoefficientDesigner.h"
+
+ResponseCurveComponent::ResponseCurveComponent(EQAudioProcessor& p)
+    : juce::Thread("EQ response curve"), audioProcessor(p)
+{
+    setInterceptsMouseClicks(false, false);
+
+    startThread();
+
+    // only checks a version number, the curve itself is never worked out on the message thread
+    startTimerHz(30);
+}
+
+ResponseCurveComponent::~ResponseCurveComponent()
+{
+    stopTimer();
+    signalThreadShouldExit();
+    notify();
+    stopThread(1000);
+}
+
+void ResponseCurveComponent::paint(juce::Graphics& g)
+{
+    PaintStatistics::ScopedMeasurement measurement(paintStatistics);
+
+    // the frame and the grid only change with the size, so they're cached in an image
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    if (!grid.isValid() || scale != gridScale)
+        renderGrid(scale);
+
+    g.drawImage(grid, getLocalBounds().toFloat());
+
+    g.setColour(juce::Colours::white);
+    g.strokePath(curve, curveStroke);
+}
+
+void ResponseCurveComponent::renderGrid(float scale)
+{
+    gridScale = scale;
+    grid = juce::Image(juce::Image::ARGB, juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+                       juce::jmax(1, juce::roundToInt(getHeight() * scale)), true);
+
+    juce::Graphics g(grid);
+    g.addTransform(juce::AffineTransform::scale(scale));
+
+    auto bounds = getLocalBounds().toFloat();
+
+    g.setColour(juce::Colours::darkgrey);
+    g.drawHorizontalLine(juce::roundToInt(bounds.getCentreY()), bounds.getX(), bounds.getRight());
+    g.drawRoundedRectangle(bounds.reduced(1.f), 4.f, 1.f);
+}
+
+void ResponseCurveComponent::resized()
+{
+    requestedWidth = getWidth();
+    requestedHeight = getHeight();
+    needsRequest = true;
+    grid = {};
+}
+
+void ResponseCurveComponent::timerCallback()
+{
+    auto version = audioProcessor.getParameterVersion();
+
+    if (needsRequest || version != lastRequestedVersion)
+    {
+        lastRequestedVersion = version;
+        needsRequest = false;
+        notify();
+    }
+
+    if (auto* newest = curves.pull())
+    {
+        // only the strip the old and new curves cover needs repainting
+        auto dirty = curveStroke.getThickness() + 2.f;
+        auto oldBounds = curve.getBounds();
+
+        curve.swapWithPath(*newest);
+        repaint(oldBounds.getUnion(curve.getBounds()).expanded(dirty).getSmallestIntegerContainer());
+    }
+}
+
+void ResponseCurveComponent::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(-1);
+
+        if (threadShouldExit())
+            break;
+
+        computeCurve(requestedWidth.load(), requestedHeight.load());
+    }
+}
+
+void ResponseCurveComponent::computeCurve(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    auto sampleRate = audioProcessor.getDesignSampleRate();
+
+    // the grid only changes with the width or the rate, otherwise it's just the coefficients
+    if (width != gridWidth || sampleRate != gridSampleRate)
+    {
+        std::vector<double> omegas(static_cast<size_t>(width));
+        auto nyquist = juce::MathConstants<double>::pi * 0.999;
+
+        for (int x = 0; x < width; ++x)
+        {
+            auto frequency = juce::mapToLog10((x + 0.5) / width, minFrequency, maxFrequency);
+            omegas[static_cast<size_t>(x)] = juce::jmin(nyquist, juce::MathConstants<double>::twoPi * frequency / sampleRate);
+        }
+
+        response.setFrequencies(omegas);
+        magnitudes.assign(omegas.size(), 1.0);
+
+        gridWidth = width;
+        gridSampleRate = sampleRate;
+    }
+
+    response.evaluate(makeChainCoefficients(audioProcessor.getChainSettings(), sampleRate), magnitudes.data());
+
+    building.clear();
+    building.preallocateSpace(width * 3);
+
+    auto toY = [height](double magnitude)
+    {
+        auto decibels = static_cast<float>(juce::Decibels::gainToDecibels(magnitude, -2.0 * maxDecibels));
+        return juce::jmap(decibels, -maxDecibels, maxDecibels, static_cast<float>(height), 0.f);
+    };
+
+    building.startNewSubPath(0.f, toY(magnitudes.front()));
+
+    for (int x = 1; x < width; ++x)
+        building.lineTo(static_cast<float>(x), toY(magnitudes[static_cast<size_t>(x)]));
+
+    curves.publish(building);
+}
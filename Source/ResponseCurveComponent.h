@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+    Draws the combined magnitude response of the low cut, peak and high cut
+    in the editor's response area. The curve is worked out on a background
+    thread, one point per pixel column, and only when the processor's
+    parameter version has moved on, so paint() just strokes a cached path.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "LatestValueExchange.h"
+#include "MagnitudeResponse.h"
+#include "PaintStatistics.h"
+
+class ResponseCurveComponent : public juce::Component,
+                               private juce::Timer,
+                               private juce::Thread
+{
+public:
+    explicit ResponseCurveComponent(EQAudioProcessor&);
+    ~ResponseCurveComponent() override;
+
+    void paint(juce::Graphics&) override;
+    void resized() override;
+
+    const PaintStatistics& getPaintStatistics() const noexcept { return paintStatistics; }
+
+    // the range of the curve's vertical axis
+    static constexpr float maxDecibels = 24.f;
+    static constexpr double minFrequency = 20.0, maxFrequency = 20000.0;
+
+private:
+    void timerCallback() override;
+    void run() override;
+
+    void computeCurve(int width, int height);
+    void renderGrid(float scale);
+
+    EQAudioProcessor& audioProcessor;
+
+    // what the curve thread should draw next, written by the message thread
+    std::atomic<int> requestedWidth{ 0 }, requestedHeight{ 0 };
+    juce::uint32 lastRequestedVersion{ 0 };
+    bool needsRequest{ true };
+
+    // curve thread only
+    int gridWidth{ 0 };
+    double gridSampleRate{ 0 };
+    MagnitudeResponse response;
+    std::vector<double> magnitudes;
+    juce::Path building;
+
+    // finished paths go from the curve thread to the message thread without locking
+    LatestValueExchange<juce::Path> curves;
+    juce::Path curve;
+    juce::PathStrokeType curveStroke{ 2.f };
+
+    juce::Image grid;
+    float gridScale{ 1.f };
+    PaintStatistics paintStatistics;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ResponseCurveComponent)
+};
@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+    A single-producer/single-consumer FIFO of mono samples for the analyzer.
+    The audio thread mixes each block down straight into the FIFO, so pushing
+    never locks or allocates, and does nothing at all while no reader has
+    switched it on. The ring itself is only allocated the first time a reader
+    switches it on, so an instance whose editor is never opened doesn't carry it.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+
+class SampleFifo
+{
+public:
+    // reader side, on the message thread: only while active does the audio thread write anything.
+    // The first time it's switched on the ring is allocated with room for at least minimumSamples,
+    // and it keeps that size from then on, so the audio thread never sees it move.
+    void setActive(bool shouldBeActive, int minimumSamples = 0)
+    {
+        if (shouldBeActive && samples.empty())
+        {
+            // nothing can be pushing yet, it has never been active
+            auto size = juce::nextPowerOfTwo(juce::jmax(minimumSamples, minimumSize));
+            samples.assign(static_cast<size_t>(size), 0.f);
+            fifo.setTotalSize(size);
+        }
+
+        // anything left over from last time is stale, drop it from the reading end
+        if (shouldBeActive && !active.load())
+            fifo.read(fifo.getNumReady());
+
+        active = shouldBeActive;
+    }
+
+    bool isActive() const noexcept { return active.load(); }
+
+    // audio thread: mixes the block down to mono. If the reader has fallen behind whatever
+    // doesn't fit is dropped, the analyzer can live with a gap. Double blocks are mixed
+    // down to float on the way in.
+    template <typename SampleType>
+    void push(const juce::dsp::AudioBlock<SampleType>& block) noexcept
+    {
+        // acquire, so the ring allocated before the first activation is visible here
+        if (!active.load(std::memory_order_acquire) || block.getNumChannels() == 0)
+            return;
+
+        auto numChannels = block.getNumChannels();
+        auto gain = 1.f / static_cast<float>(numChannels);
+        auto numToWrite = juce::jmin(static_cast<int>(block.getNumSamples()), fifo.getFreeSpace());
+
+        const auto write = fifo.write(numToWrite);
+
+        auto mixInto = [&](int fifoStart, int blockStart, int num)
+        {
+            auto* dest = samples.data() + fifoStart;
+
+            if constexpr (std::is_same<SampleType, float>::value)
+            {
+                juce::FloatVectorOperations::copyWithMultiply(dest, block.getChannelPointer(0) + blockStart, gain, num);
+
+                for (size_t ch = 1; ch < numChannels; ++ch)
+                    juce::FloatVectorOperations::addWithMultiply(dest, block.getChannelPointer(ch) + blockStart, gain, num);
+            }
+            else
+            {
+                std::fill_n(dest, num, 0.f);
+
+                for (size_t ch = 0; ch < numChannels; ++ch)
+                {
+                    auto* source = block.getChannelPointer(ch) + blockStart;
+
+                    for (int i = 0; i < num; ++i)
+                        dest[i] += gain * static_cast<float>(source[i]);
+                }
+            }
+        };
+
+        if (write.blockSize1 > 0)
+            mixInto(write.startIndex1, 0, write.blockSize1);
+
+        if (write.blockSize2 > 0)
+            mixInto(write.startIndex2, write.blockSize1, write.blockSize2);
+    }
+
+    // reader side: copies up to maxSamples into dest and returns how many there were
+    int pull(float* dest, int maxSamples) noexcept
+    {
+        if (samples.empty())
+            return 0;
+
+        const auto read = fifo.read(juce::jmin(maxSamples, fifo.getNumReady()));
+
+        if (read.blockSize1 > 0)
+            std::copy_n(samples.data() + read.startIndex1, read.blockSize1, dest);
+
+        if (read.blockSize2 > 0)
+            std::copy_n(samples.data() + read.startIndex2, read.blockSize2, dest + read.blockSize1);
+
+        return read.blockSize1 + read.blockSize2;
+    }
+
+private:
+    static constexpr int minimumSize = 1024;
+
+    // a placeholder size until the ring is allocated
+    juce::AbstractFifo fifo{ 1 };
+    std::vector<float> samples;
+    std::atomic<bool> active{ false };
+};
@@ -0,0 +1,600 @@
+/*
+  ==============================================================================
+    Spectral matching, see SpectralMatch.h.
+  ==============================================================================
+*/
+#include "SpectralMatch.h"
+#include "CoefficientDesigner.h"
+#include "MagnitudeResponse.h"
+
+namespace
+{
+    // 8192 points is under 6 Hz per bin at 48 kHz, fine enough for a sixth of an octave at 20 Hz
+    constexpr int fftOrder = 13;
+    constexpr int fftSize = 1 << fftOrder;
+    constexpr int hopSize = fftSize / 2;
+    constexpr int numBins = fftSize / 2 + 1;
+
+    constexpr double pointsPerOctave = 6.0;
+    constexpr double lowestFrequency = 20.0, highestFrequency = 20000.0;
+
+    // the top few percent below Nyquist are left out, the converters' filters are already working there
+    constexpr double highestUsableFraction = 0.45;
+
+    // frequencies more than this far below the loudest point of either file are noise floor,
+    // there's nothing there for an EQ to match
+    constexpr double floorBelowPeakDb = 80.0;
+
+    // the fit never asks for more than this, the gain parameters stop at 24 dB anyway
+    constexpr double maxCorrectionDb = 24.0;
+
+    // stops adding bands once one takes less than this off the error
+    constexpr double minimumImprovement = 0.02;
+
+    //==============================================================================
+    // one contiguous range of FFT frames, read through its own reader
+    struct Analysis
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        juce::int64 firstFrame{ 0 }, numFrames{ 0 };
+        std::vector<double> power;
+
+        void run(std::atomic<juce::int64>& framesDone, const std::atomic<bool>* shouldStop)
+        {
+            auto numChannels = static_cast<int>(reader->numChannels);
+
+            juce::dsp::FFT fft(fftOrder);
+            std::vector<float> window(fftSize), fftData(fftSize * 2);
+            juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+
+            // only ever one frame of every channel: each step shifts half of it out and reads a hop in
+            juce::AudioBuffer<float> frame(numChannels, fftSize);
+            auto position = firstFrame * hopSize;
+            reader->read(&frame, 0, fftSize, position, true, true);
+            position += fftSize;
+
+            power.assign(numBins, 0.0);
+
+            for (juce::int64 i = 0; i < numFrames; ++i)
+            {
+                if (shouldStop != nullptr && shouldStop->load())
+                    return;
+
+                if (i > 0)
+                {
+                    for (int ch = 0; ch < numChannels; ++ch)
+                    {
+                        auto* samples = frame.getWritePointer(ch);
+                        std::memmove(samples, samples + hopSize, sizeof(float) * hopSize);
+                    }
+
+                    reader->read(&frame, hopSize, hopSize, position, true, true);
+                    position += hopSize;
+                }
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                {
+                    juce::FloatVectorOperations::multiply(fftData.data(), frame.getReadPointer(ch), window.data(), fftSize);
+                    fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+                    for (int bin = 0; bin < numBins; ++bin)
+                        power[static_cast<size_t>(bin)] += static_cast<double>(fftData[static_cast<size_t>(bin)]) * fftData[static_cast<size_t>(bin)];
+                }
+
+                ++framesDone;
+            }
+        }
+    };
+
+    // averages the bins in a sixth of an octave around each point. At the bottom a band can be
+    // narrower than a bin, those points are interpolated between the two nearest bins instead.
+    std::vector<double> toAnalysisPoints(const std::vector<double>& power, double sampleRate)
+    {
+        std::vector<double> levelsDb;
+        auto binWidth = sampleRate / fftSize;
+        auto halfBand = std::pow(2.0, 0.5 / pointsPerOctave);
+
+        for (auto frequency : SpectralMatch::getAnalysisFrequencies())
+        {
+            if (frequency >= highestUsableFraction * sampleRate)
+                break;
+
+            auto first = static_cast<int>(std::ceil(frequency / halfBand / binWidth));
+            auto last = juce::jmin(numBins - 1, static_cast<int>(std::floor(frequency * halfBand / binWidth)));
+            auto level = 0.0;
+
+            if (last >= first)
+            {
+                for (int bin = first; bin <= last; ++bin)
+                    level += power[static_cast<size_t>(bin)];
+
+                level /= last - first + 1;
+            }
+            else
+            {
+                auto position = frequency / binWidth;
+                auto below = juce::jlimit(0, numBins - 2, static_cast<int>(position));
+                auto fraction = position - below;
+                level = power[static_cast<size_t>(below)] * (1.0 - fraction) + power[static_cast<size_t>(below + 1)] * fraction;
+            }
+
+            levelsDb.push_back(10.0 * std::log10(level + 1.0e-30));
+        }
+
+        return levelsDb;
+    }
+
+    //==============================================================================
+    // a value the fit can move. Frequencies and Q move in octaves, gains in dB.
+    struct Knob
+    {
+        float* value;
+        float minimum, maximum;
+        bool logarithmic;
+    };
+
+    Knob frequencyKnob(float& value) { return { &value, 20.f, 20000.f, true }; }
+    Knob gainKnob(float& value)      { return { &value, static_cast<float>(-maxCorrectionDb), static_cast<float>(maxCorrectionDb), false }; }
+    Knob qualityKnob(float& value)   { return { &value, 0.1f, 10.f, true }; }
+
+    // the mean squared difference in dB between a chain's response and the target, at the
+    // material's rate so the cuts and the cramping near Nyquist come out the way they'll sound
+    class Fitter
+    {
+    public:
+        Fitter(std::vector<double> targetDb, std::vector<double> pointWeights, double rate)
+            : target(std::move(targetDb)), weights(std::move(pointWeights)), sampleRate(rate)
+        {
+            std::vector<double> omegas;
+
+            for (size_t i = 0; i < target.size(); ++i)
+                omegas.push_back(juce::MathConstants<double>::twoPi * SpectralMatch::getAnalysisFrequencies()[i] / sampleRate);
+
+            response.setFrequencies(omegas);
+            magnitudes.resize(target.size());
+            totalWeight = juce::jmax(1.0, std::accumulate(weights.begin(), weights.end(), 0.0));
+        }
+
+        double getError(const chainsettings& settings)
+        {
+            evaluate(settings);
+            auto error = 0.0;
+
+            for (size_t i = 0; i < target.size(); ++i)
+            {
+                auto difference = getResponseDb(i) - target[i];
+                error += weights[i] * difference * difference;
+            }
+
+            return error / totalWeight;
+        }
+
+        // the point where the chain is furthest off, and by how much it needs to go up or down there
+        std::pair<size_t, double> getWorstPoint(const chainsettings& settings)
+        {
+            evaluate(settings);
+            std::pair<size_t, double> worst{ 0, 0.0 };
+
+            for (size_t i = 0; i < target.size(); ++i)
+            {
+                auto residual = weights[i] > 0 ? target[i] - getResponseDb(i) : 0.0;
+
+                if (std::abs(residual) > std::abs(worst.second))
+                    worst = { i, residual };
+            }
+
+            return worst;
+        }
+
+        // coordinate descent: each knob in turn takes a step either way if that helps, and its step
+        // halves when neither does, until every step is down to a twenty-fourth of an octave or 0.1 dB
+        double refine(chainsettings& settings, const std::vector<Knob>& knobs)
+        {
+            auto error = getError(settings);
+            std::vector<double> steps;
+
+            for (auto& knob : knobs)
+                steps.push_back(knob.logarithmic ? 0.5 : 3.0);
+
+            for (int pass = 0; pass < 200; ++pass)
+            {
+                auto anyStepLeft = false;
+
+                for (size_t k = 0; k < knobs.size(); ++k)
+                {
+                    auto& knob = knobs[k];
+                    auto minimumStep = knob.logarithmic ? 1.0 / 24.0 : 0.1;
+
+                    if (steps[k] < minimumStep)
+                        continue;
+
+                    anyStepLeft = true;
+                    auto original = *knob.value;
+                    auto improved = false;
+
+                    for (auto direction : { 1.0, -1.0 })
+                    {
+                        auto moved = knob.logarithmic ? original * std::pow(2.0, direction * steps[k])
+                                                      : original + direction * steps[k];
+
+                        *knob.value = juce::jlimit(knob.minimum, knob.maximum, static_cast<float>(moved));
+                        auto movedError = getError(settings);
+
+                        if (movedError < error)
+                        {
+                            error = movedError;
+                            improved = true;
+                            break;
+                        }
+
+                        *knob.value = original;
+                    }
+
+                    if (!improved)
+                        steps[k] *= 0.5;
+                }
+
+                if (!anyStepLeft)
+                    break;
+            }
+
+            return error;
+        }
+
+    private:
+        void evaluate(const chainsettings& settings)
+        {
+            response.evaluate(makeChainCoefficients(settings, sampleRate), magnitudes.data());
+        }
+
+        // limited the same way as the target, so a cut going further down than it asks for isn't held against it
+        double getResponseDb(size_t i) const
+        {
+            return juce::jlimit(-maxCorrectionDb, maxCorrectionDb, juce::Decibels::gainToDecibels(magnitudes[i], -200.0));
+        }
+
+        std::vector<double> target, weights, magnitudes;
+        double sampleRate, totalWeight{ 1.0 };
+        MagnitudeResponse response;
+    };
+
+    // tries every point and slope for one cut, including leaving it off
+    template <typename Predicate>
+    double searchCut(Fitter& fitter, chainsettings& settings, float& frequency, Slope& slope, float off, Predicate isCandidate)
+    {
+        auto bestFrequency = off;
+        auto bestSlope = Slope1;
+        frequency = off;
+        auto bestError = fitter.getError(settings);
+
+        for (auto candidate : SpectralMatch::getAnalysisFrequencies())
+        {
+            if (!isCandidate(candidate))
+                continue;
+
+            for (auto candidateSlope : { Slope1, Slope2, Slope3, Slope4 })
+            {
+                frequency = static_cast<float>(candidate);
+                slope = candidateSlope;
+                auto error = fitter.getError(settings);
+
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestFrequency = frequency;
+                    bestSlope = candidateSlope;
+                }
+            }
+        }
+
+        frequency = bestFrequency;
+        slope = bestSlope;
+        return bestError;
+    }
+}
+
+//==============================================================================
+const std::vector<double>& SpectralMatch::getAnalysisFrequencies()
+{
+    static const std::vector<double> frequencies = []
+    {
+        std::vector<double> points;
+
+        for (int i = 0; lowestFrequency * std::pow(2.0, i / pointsPerOctave) <= highestFrequency * 1.0001; ++i)
+            points.push_back(lowestFrequency * std::pow(2.0, i / pointsPerOctave));
+
+        return points;
+    }();
+
+    return frequencies;
+}
+
+SpectralMatch::Spectrum SpectralMatch::analyseFile(juce::AudioFormatManager& formatManager, const juce::File& file, int numThreads,
+                                                   std::atomic<float>* progress, const std::atomic<bool>* shouldStop)
+{
+    std::unique_ptr<juce::AudioFormatReader> firstReader(formatManager.createReaderFor(file));
+
+    if (firstReader == nullptr || firstReader->numChannels == 0 || firstReader->sampleRate <= 0)
+        return {};
+
+    // anything shorter than one frame is analysed as a single zero-padded frame, and the last
+    // part-hop of a longer file is left out
+    Spectrum spectrum;
+    spectrum.sampleRate = firstReader->sampleRate;
+    spectrum.numFrames = firstReader->lengthInSamples <= fftSize ? 1 : 1 + (firstReader->lengthInSamples - fftSize) / hopSize;
+
+    // a contiguous range of frames per thread, each with its own reader since readers can't be shared.
+    // The readers are all made here, the format manager isn't meant to be used from several threads.
+    auto numAnalyses = static_cast<int>(juce::jlimit<juce::int64>(1, juce::jmax(1, numThreads), spectrum.numFrames));
+    std::vector<Analysis> analyses(static_cast<size_t>(numAnalyses));
+
+    for (int i = 0; i < numAnalyses; ++i)
+    {
+        auto& analysis = analyses[static_cast<size_t>(i)];
+        analysis.firstFrame = spectrum.numFrames * i / numAnalyses;
+        analysis.numFrames = spectrum.numFrames * (i + 1) / numAnalyses - analysis.firstFrame;
+        analysis.reader.reset(i == 0 ? firstReader.release() : formatManager.createReaderFor(file));
+
+        if (analysis.reader == nullptr)
+            return {};
+    }
+
+    std::atomic<juce::int64> framesDone{ 0 };
+
+    auto updateProgress = [&]
+    {
+        if (progress != nullptr)
+            progress->store(static_cast<float>(framesDone.load()) / static_cast<float>(spectrum.numFrames));
+    };
+
+    if (numAnalyses == 1)
+    {
+        analyses.front().run(framesDone, shouldStop);
+    }
+    else
+    {
+        juce::ThreadPool pool(numAnalyses);
+
+        for (auto& analysis : analyses)
+            pool.addJob([&analysis, &framesDone, shouldStop] { analysis.run(framesDone, shouldStop); });
+
+        while (pool.getNumJobs() > 0)
+        {
+            updateProgress();
+            juce::Thread::sleep(50);
+        }
+    }
+
+    if (shouldStop != nullptr && shouldStop->load())
+        return {};
+
+    updateProgress();
+
+    std::vector<double> power(numBins, 0.0);
+
+    for (auto& analysis : analyses)
+        for (size_t bin = 0; bin < power.size(); ++bin)
+            power[bin] += analysis.power[bin];
+
+    auto numSpectra = static_cast<double>(spectrum.numFrames) * analyses.front().reader->numChannels;
+
+    for (auto& bin : power)
+        bin /= numSpectra;
+
+    spectrum.levelsDb = toAnalysisPoints(power, spectrum.sampleRate);
+    return spectrum;
+}
+
+chainsettings SpectralMatch::fit(const Spectrum& reference, const Spectrum& material, int numBands, const chainsettings& base)
+{
+    // start from flat, with the cuts off
+    auto settings = base;
+    settings.lowCutFreq = 20.f;
+    settings.highCutFreq = 20000.f;
+    settings.lowCutSlope = settings.highCutSlope = Slope1;
+    settings.peakFreq = 1000.f;
+    settings.peakGain = 0.f;
+    settings.peakQuality = 1.f;
+
+    numBands = juce::jlimit(0, maxBands, numBands);
+
+    for (int i = 0; i < numBands; ++i)
+        settings.bands[static_cast<size_t>(i)] = {};
+
+    auto numPoints = juce::jmin(reference.levelsDb.size(), material.levelsDb.size());
+
+    if (numPoints == 0)
+        return settings;
+
+    auto loudestReference = *std::max_element(reference.levelsDb.begin(), reference.levelsDb.begin() + static_cast<std::ptrdiff_t>(numPoints));
+    auto loudestMaterial = *std::max_element(material.levelsDb.begin(), material.levelsDb.begin() + static_cast<std::ptrdiff_t>(numPoints));
+
+    std::vector<double> target(numPoints), weights(numPoints), usable;
+
+    for (size_t i = 0; i < numPoints; ++i)
+    {
+        target[i] = reference.levelsDb[i] - material.levelsDb[i];
+        weights[i] = reference.levelsDb[i] > loudestReference - floorBelowPeakDb
+                  && material.levelsDb[i] > loudestMaterial - floorBelowPeakDb ? 1.0 : 0.0;
+
+        if (weights[i] > 0)
+            usable.push_back(target[i]);
+    }
+
+    if (usable.empty())
+        return settings;
+
+    // the overall level difference comes off, the median so a big resonance doesn't drag it around
+    std::nth_element(usable.begin(), usable.begin() + static_cast<std::ptrdiff_t>(usable.size() / 2), usable.end());
+    auto offset = usable[usable.size() / 2];
+
+    for (auto& point : target)
+        point = juce::jlimit(-maxCorrectionDb, maxCorrectionDb, point - offset);
+
+    Fitter fitter(std::move(target), std::move(weights), material.sampleRate);
+
+    // the cuts first, everything else is flat so they only go in where the target really falls away
+    searchCut(fitter, settings, settings.lowCutFreq, settings.lowCutSlope, 20.f, [](double f) { return f <= 1000.0; });
+    auto error = searchCut(fitter, settings, settings.highCutFreq, settings.highCutSlope, 20000.f, [](double f) { return f >= 1000.0; });
+
+    std::vector<Knob> knobs{ frequencyKnob(settings.lowCutFreq), frequencyKnob(settings.highCutFreq) };
+
+    // then the peak where the largest difference is left, refined together with the cuts
+    {
+        auto withoutPeak = settings;
+        auto worst = fitter.getWorstPoint(settings);
+
+        settings.peakFreq = static_cast<float>(getAnalysisFrequencies()[worst.first]);
+        settings.peakGain = static_cast<float>(worst.second);
+
+        auto peakKnobs = knobs;
+        peakKnobs.push_back(frequencyKnob(settings.peakFreq));
+        peakKnobs.push_back(gainKnob(settings.peakGain));
+        peakKnobs.push_back(qualityKnob(settings.peakQuality));
+
+        auto withPeak = fitter.refine(settings, peakKnobs);
+
+        if (withPeak < error)
+        {
+            error = withPeak;
+            knobs = peakKnobs;
+        }
+        else
+        {
+            settings = withoutPeak;
+        }
+    }
+
+    // each extra band goes after whatever is left, as whichever of a peak or a shelf fits best.
+    // Only the new band moves while it's chosen, which keeps this quick with many bands.
+    for (int i = 0; i < numBands; ++i)
+    {
+        auto& band = settings.bands[static_cast<size_t>(i)];
+        auto worst = fitter.getWorstPoint(settings);
+        auto bestError = error;
+        BandSettings bestBand;
+
+        for (auto type : { BandPeak, BandLowShelf, BandHighShelf })
+        {
+            band.type = type;
+            band.freq = static_cast<float>(getAnalysisFrequencies()[worst.first]);
+            band.gain = static_cast<float>(worst.second);
+            band.quality = 0.71f;
+
+            auto bandError = fitter.refine(settings, { frequencyKnob(band.freq), gainKnob(band.gain), qualityKnob(band.quality) });
+
+            if (bandError < bestError)
+            {
+                bestError = bandError;
+                bestBand = band;
+            }
+        }
+
+        band = bestBand;
+
+        if (band.type == BandOff || bestError > error * (1.0 - minimumImprovement))
+        {
+            band = {};
+            break;
+        }
+
+        error = bestError;
+        knobs.push_back(frequencyKnob(band.freq));
+        knobs.push_back(gainKnob(band.gain));
+        knobs.push_back(qualityKnob(band.quality));
+    }
+
+    // and a last pass with everything free to move, so the earlier stages can make room for the later ones
+    fitter.refine(settings, knobs);
+    return settings;
+}
+
+//==============================================================================
+SpectralMatch::Matcher::Matcher()
+    : juce::Thread("EQ spectral match")
+{
+}
+
+SpectralMatch::Matcher::~Matcher()
+{
+    stopping = true;
+    stopThread(10000);
+}
+
+void SpectralMatch::Matcher::start(const juce::File& reference, const juce::File& material, int numBands, const chainsettings& base)
+{
+    if (state.load() == State::running)
+        return;
+
+    // the last run has finished, but the thread may still be on its way out
+    stopThread(1000);
+
+    // every instance has a matcher, the formats are only registered once one is used
+    if (formatManager.getNumKnownFormats() == 0)
+        formatManager.registerBasicFormats();
+
+    referenceFile = reference;
+    materialFile = material;
+    bandsToFit = numBands;
+    baseSettings = base;
+    error.clear();
+
+    stopping = false;
+    filesDone = 0;
+    fileProgress = 0.f;
+    state = State::running;
+    startThread();
+}
+
+chainsettings SpectralMatch::Matcher::takeResult()
+{
+    jassert(state.load() == State::finished);
+    state = State::idle;
+    return result;
+}
+
+juce::String SpectralMatch::Matcher::takeError()
+{
+    jassert(state.load() == State::failed);
+    state = State::idle;
+    return error;
+}
+
+void SpectralMatch::Matcher::run()
+{
+    auto numThreads = juce::SystemStats::getNumCpus();
+    Spectrum spectra[2];
+    const juce::File* files[2]{ &referenceFile, &materialFile };
+
+    for (int i = 0; i < 2; ++i)
+    {
+        spectra[i] = analyseFile(formatManager, *files[i], numThreads, &fileProgress, &stopping);
+
+        if (stopping.load())
+        {
+            state = State::idle;
+            return;
+        }
+
+        if (!spectra[i].isValid())
+        {
+            error = "Couldn't read " + files[i]->getFileName();
+            state = State::failed;
+
+            if (onFinished != nullptr)
+                onFinished();
+
+            return;
+        }
+
+        fileProgress = 0.f;
+        ++filesDone;
+    }
+
+    // the fit takes well under a second, it doesn't get a share of the progress
+    result = fit(spectra[0], spectra[1], bandsToFit, baseSettings);
+    state = State::finished;
+
+    if (onFinished != nullptr)
+        onFinished();
+}
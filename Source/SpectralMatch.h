@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+    Spectral matching: measures the long-term average spectrum of a reference
+    file and of the material, then fits the low cut, peak, high cut and some
+    of the extra bands to the difference between them. The files are streamed
+    in FFT-sized frames over several threads, so an hour of audio takes
+    seconds and memory doesn't grow with the length of the file.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChainSettings.h"
+
+namespace SpectralMatch
+{
+    // the average level at each of getAnalysisFrequencies(), in dB. Points at or above
+    // Nyquist are left out, so there can be fewer levels than frequencies.
+    struct Spectrum
+    {
+        std::vector<double> levelsDb;
+        double sampleRate{ 0 };
+        juce::int64 numFrames{ 0 };
+
+        bool isValid() const noexcept { return numFrames > 0 && !levelsDb.empty(); }
+    };
+
+    // sixth-octave points from 20 Hz to 20 kHz
+    const std::vector<double>& getAnalysisFrequencies();
+
+    // averages the power spectrum of every channel over the whole file (Hann window, 50% overlap).
+    // The file is split into one range per thread and each reads its own range, so only a
+    // few frames per thread are ever held. progress goes from 0 to 1, and setting shouldStop
+    // makes it return early with an invalid spectrum.
+    Spectrum analyseFile(juce::AudioFormatManager& formatManager, const juce::File& file, int numThreads,
+                         std::atomic<float>* progress = nullptr, const std::atomic<bool>* shouldStop = nullptr);
+
+    // settings that turn material's spectrum into the reference's, ignoring the overall level
+    // (EQ can't fix that without changing the loudness). The cuts and the peak are always
+    // fitted, then up to numBands of the extra bands for whatever is left, stopping early once
+    // another band wouldn't help much. Everything else, and the bands beyond numBands, comes
+    // from base. The peak is fitted as a static peak, with the dynamic mode on it only gets
+    // there above the threshold.
+    chainsettings fit(const Spectrum& reference, const Spectrum& material, int numBands, const chainsettings& base);
+
+    // runs both analyses and the fit on a background thread. The editor polls it, since the
+    // job can outlive the editor that started it.
+    class Matcher : private juce::Thread
+    {
+    public:
+        enum class State
+        {
+            idle,
+            running,
+            finished,
+            failed
+        };
+
+        Matcher();
+        ~Matcher() override;
+
+        // message thread. Ignored while a match is already running.
+        void start(const juce::File& reference, const juce::File& material, int numBands, const chainsettings& base);
+
+        State getState() const noexcept { return state.load(); }
+        // each file is half of it
+        float getProgress() const noexcept { return 0.5f * (static_cast<float>(filesDone.load()) + fileProgress.load()); }
+        // once finished, hands over the fitted settings and goes back to idle. The settings
+        // cover the cuts, the peak and the first getNumBands() extra bands.
+        chainsettings takeResult();
+        int getNumBands() const noexcept { return bandsToFit; }
+
+        // once failed, says why and goes back to idle
+        juce::String takeError();
+
+        // called on the matcher's thread once a match has finished or failed, not when it's stopped
+        std::function<void()> onFinished;
+
+    private:
+        void run() override;
+
+        juce::AudioFormatManager formatManager;
+        juce::File referenceFile, materialFile;
+        int bandsToFit{ 0 };
+        chainsettings baseSettings, result;
+        juce::String error;
+
+        std::atomic<State> state{ State::idle };
+        std::atomic<int> filesDone{ 0 };
+        std::atomic<float> fileProgress{ 0.f };
+        std::atomic<bool> stopping{ false };
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Matcher)
+    };
+}
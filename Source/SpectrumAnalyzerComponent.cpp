@@ -0,0 +1,212 @@
+/*
+  ==============================================================================
+    Shows the input and output spectrum behind the response curve. The
+    processor only mixes samples into two FIFOs; a background thread owned
+    by this component windows them, runs the FFTs, averages the bins and
+    builds the paths. Nothing runs while the component is switched off or
+    the editor is closed.
+  ==============================================================================
+*/
+#include "SpectrumAnalyzerComponent.h"
+#include "ResponseCurveComponent.h"
+
+namespace
+{
+    // how much of each new spectrum goes into the running average
+    constexpr float averagingCoefficient = 0.25f;
+}
+
+SpectrumAnalyzerComponent::SpectrumAnalyzerComponent(EQAudioProcessor& p)
+    : juce::Thread("EQ spectrum analyzer"), audioProcessor(p),
+      pre(p.analyzerInput), post(p.analyzerOutput)
+{
+    setInterceptsMouseClicks(false, false);
+
+    window.resize(fftSize);
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+    windowGain = std::accumulate(window.begin(), window.end(), 0.f) * 0.5f;
+
+    scratch.resize(hopSize);
+
+    for (auto* tap : { &pre, &post })
+    {
+        tap->history.assign(fftSize, 0.f);
+        tap->fftData.assign(fftSize * 2, 0.f);
+        tap->averageDecibels.assign(fftSize / 2 + 1, minDecibels);
+    }
+
+    startThread();
+    setAnalyzerOn(true);
+}
+
+SpectrumAnalyzerComponent::~SpectrumAnalyzerComponent()
+{
+    setAnalyzerOn(false);
+    signalThreadShouldExit();
+    notify();
+    stopThread(1000);
+}
+
+void SpectrumAnalyzerComponent::setAnalyzerOn(bool shouldBeOn)
+{
+    analyzerOn = shouldBeOn;
+
+    // room for a tenth of a second, several frames of the 60 Hz timer, and never less than four
+    // hops. Made the first time it's on, from whatever rate the processor has by then.
+    auto sampleRate = audioProcessor.getSampleRate() > 0.0 ? audioProcessor.getSampleRate() : 48000.0;
+    auto fifoSamples = juce::jmax(hopSize * 4, static_cast<int>(sampleRate * 0.1));
+
+    pre.fifo.setActive(shouldBeOn, fifoSamples);
+    post.fifo.setActive(shouldBeOn, fifoSamples);
+
+    if (shouldBeOn)
+    {
+        startTimerHz(60);
+        notify();
+    }
+    else
+    {
+        stopTimer();
+        showing.pre.clear();
+        showing.post.clear();
+        repaint();
+    }
+}
+
+void SpectrumAnalyzerComponent::paint(juce::Graphics& g)
+{
+    PaintStatistics::ScopedMeasurement measurement(paintStatistics);
+
+    g.setColour(juce::Colours::grey.withAlpha(0.6f));
+    g.strokePath(showing.pre, juce::PathStrokeType(1.f));
+
+    g.setColour(juce::Colours::lightblue.withAlpha(0.8f));
+    g.strokePath(showing.post, juce::PathStrokeType(1.5f));
+}
+
+void SpectrumAnalyzerComponent::resized()
+{
+    pathWidth = getWidth();
+    pathHeight = getHeight();
+}
+
+void SpectrumAnalyzerComponent::timerCallback()
+{
+    if (auto* newest = exchange.pull())
+    {
+        // the spectrum moves everywhere, but usually not all the way up, so only the
+        // area both the old and new paths cover is repainted
+        auto dirty = showing.pre.getBounds().getUnion(showing.post.getBounds());
+
+        showing.pre.swapWithPath(newest->pre);
+        showing.post.swapWithPath(newest->post);
+
+        dirty = dirty.getUnion(showing.pre.getBounds()).getUnion(showing.post.getBounds());
+        repaint(dirty.expanded(2.f).getSmallestIntegerContainer());
+    }
+}
+
+void SpectrumAnalyzerComponent::run()
+{
+    while (!threadShouldExit())
+    {
+        // about once a frame while it's on, otherwise asleep until it's switched back on
+        wait(pre.fifo.isActive() ? 16 : -1);
+
+        // both taps are always read so neither FIFO fills up while the other has news
+        auto preUpdated = readTap(pre);
+        auto postUpdated = readTap(post);
+
+        auto width = pathWidth.load();
+        auto height = pathHeight.load();
+        auto sampleRate = audioProcessor.getSampleRate();
+
+        if (!(preUpdated || postUpdated) || width <= 0 || height <= 0 || sampleRate <= 0)
+            continue;
+
+        buildPath(pre, building.pre, width, height, sampleRate);
+        buildPath(post, building.post, width, height, sampleRate);
+
+        exchange.publish(building);
+    }
+}
+
+bool SpectrumAnalyzerComponent::readTap(Tap& tap)
+{
+    auto updated = false;
+
+    for (;;)
+    {
+        auto numRead = tap.fifo.pull(scratch.data(), hopSize - tap.samplesSinceLastFft);
+
+        if (numRead == 0)
+            return updated;
+
+        std::move(tap.history.begin() + numRead, tap.history.end(), tap.history.begin());
+        std::copy_n(scratch.begin(), numRead, tap.history.end() - numRead);
+
+        tap.samplesSinceLastFft += numRead;
+
+        if (tap.samplesSinceLastFft < hopSize)
+            continue;
+
+        tap.samplesSinceLastFft = 0;
+
+        juce::FloatVectorOperations::multiply(tap.fftData.data(), tap.history.data(), window.data(), fftSize);
+        std::fill(tap.fftData.begin() + fftSize, tap.fftData.end(), 0.f);
+
+        fft.performFrequencyOnlyForwardTransform(tap.fftData.data());
+
+        for (size_t bin = 0; bin < tap.averageDecibels.size(); ++bin)
+        {
+            auto decibels = juce::Decibels::gainToDecibels(tap.fftData[bin] / windowGain, minDecibels);
+            auto& average = tap.averageDecibels[bin];
+            average += averagingCoefficient * (decibels - average);
+        }
+
+        updated = true;
+    }
+}
+
+void SpectrumAnalyzerComponent::buildPath(const Tap& tap, juce::Path& path, int width, int height, double sampleRate) const
+{
+    path.clear();
+    path.preallocateSpace(width * 3);
+
+    auto binsPerHertz = fftSize / sampleRate;
+    auto lastBin = static_cast<double>(tap.averageDecibels.size() - 1);
+
+    auto levelAt = [&](size_t bin) { return tap.averageDecibels[bin]; };
+
+    for (int x = 0; x < width; ++x)
+    {
+        auto lowBin = juce::jmin(lastBin, juce::mapToLog10(static_cast<double>(x) / width, ResponseCurveComponent::minFrequency, ResponseCurveComponent::maxFrequency) * binsPerHertz);
+        auto highBin = juce::jmin(lastBin, juce::mapToLog10(static_cast<double>(x + 1) / width, ResponseCurveComponent::minFrequency, ResponseCurveComponent::maxFrequency) * binsPerHertz);
+
+        float level;
+
+        if (highBin - lowBin < 1.0)
+        {
+            // at the bottom end a column is narrower than a bin, so interpolate between bins
+            auto position = (lowBin + highBin) * 0.5;
+            auto index = juce::jmin(static_cast<size_t>(position), static_cast<size_t>(lastBin) - 1);
+            auto fraction = static_cast<float>(position - static_cast<double>(index));
+            level = levelAt(index) + fraction * (levelAt(index + 1) - levelAt(index));
+        }
+        else
+        {
+            // higher up a column covers several bins, show the loudest of them
+            level = minDecibels;
+
+            for (auto bin = static_cast<size_t>(std::ceil(lowBin)); bin <= static_cast<size_t>(highBin); ++bin)
+                level = juce::jmax(level, levelAt(bin));
+        }
+
+        auto y = juce::jmap(juce::jlimit(minDecibels, maxDecibels, level), minDecibels, maxDecibels, static_cast<float>(height), 0.f);
+
+        if (x == 0)
+            path.startNewSubPath(0.f, y);
+        else
+            path.lineTo(static_cast<float>(x), y);
+    }
+}
@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+    Shows the input and output spectrum behind the response curve. The
+    processor only mixes samples into two FIFOs; a background thread owned
+    by this component windows them, runs the FFTs, averages the bins and
+    builds the paths. Nothing runs while the component is switched off or
+    the editor is closed.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "LatestValueExchange.h"
+#include "PaintStatistics.h"
+
+class SpectrumAnalyzerComponent : public juce::Component,
+                                  private juce::Timer,
+                                  private juce::Thread
+{
+public:
+    explicit SpectrumAnalyzerComponent(EQAudioProcessor&);
+    ~SpectrumAnalyzerComponent() override;
+
+    // turning it off stops the FIFOs, the FFT thread and the repaints
+    void setAnalyzerOn(bool shouldBeOn);
+    bool isAnalyzerOn() const noexcept { return analyzerOn; }
+
+    void paint(juce::Graphics&) override;
+    void resized() override;
+
+    const PaintStatistics& getPaintStatistics() const noexcept { return paintStatistics; }
+
+    // the range of the vertical axis in dBFS
+    static constexpr float minDecibels = -90.f, maxDecibels = 6.f;
+
+private:
+    // one per FIFO: the last fftSize samples, and the averaged spectrum built from them
+    struct Tap
+    {
+        explicit Tap(SampleFifo& source) : fifo(source) {}
+
+        SampleFifo& fifo;
+        std::vector<float> history, fftData, averageDecibels;
+        int samplesSinceLastFft{ 0 };
+    };
+
+    struct Paths
+    {
+        juce::Path pre, post;
+    };
+
+    void timerCallback() override;
+    void run() override;
+
+    bool readTap(Tap&);
+    void buildPath(const Tap&, juce::Path&, int width, int height, double sampleRate) const;
+
+    static constexpr int fftOrder = 12;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = fftSize / 4;
+
+    EQAudioProcessor& audioProcessor;
+    bool analyzerOn{ false };
+
+    std::atomic<int> pathWidth{ 0 }, pathHeight{ 0 };
+
+    // FFT thread only
+    juce::dsp::FFT fft{ fftOrder };
+    std::vector<float> window, scratch;
+    float windowGain{ 1.f };
+    Tap pre, post;
+    Paths building;
+
+    // the FFT thread copies finished paths in and the message thread swaps them out,
+    // so painting never allocates
+    LatestValueExchange<Paths> exchange;
+    Paths showing;
+    PaintStatistics paintStatistics;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrumAnalyzerComponent)
+};
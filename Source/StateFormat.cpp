@@ -0,0 +1,137 @@
+/*
+  ==============================================================================
+    The plugin's saved state: a small versioned binary format instead of XML.
+    See StateFormat.h for the layout.
+  ==============================================================================
+*/
+#include "StateFormat.h"
+
+namespace
+{
+    constexpr int headerSize = 8;
+
+    struct Entry
+    {
+        const char* id{ nullptr };
+        int idLength{ 0 };
+        float value{ 0 };
+    };
+
+    // points the entry at its ID inside the block rather than copying it out.
+    // Returns false if the data runs out part way through.
+    bool readEntry(juce::MemoryInputStream& in, Entry& entry)
+    {
+        if (in.getNumBytesRemaining() < 1)
+            return false;
+
+        entry.idLength = static_cast<juce::uint8>(in.readByte());
+
+        if (in.getNumBytesRemaining() < entry.idLength + 4)
+            return false;
+
+        entry.id = static_cast<const char*>(in.getData()) + in.getPosition();
+        in.skipNextBytes(entry.idLength);
+        entry.value = in.readFloat();
+        return true;
+    }
+
+    // compares the raw UTF-8 so no String has to be built per entry
+    juce::RangedAudioParameter* findParameter(const juce::Array<juce::AudioProcessorParameter*>& parameters, const Entry& entry, int& index)
+    {
+        for (index = 0; index < parameters.size(); ++index)
+        {
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameters.getUnchecked(index)))
+            {
+                if (static_cast<int>(ranged->paramID.getNumBytesAsUTF8()) == entry.idLength
+                     && std::memcmp(ranged->paramID.toRawUTF8(), entry.id, static_cast<size_t>(entry.idLength)) == 0)
+                    return ranged;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void setIfChanged(juce::RangedAudioParameter& parameter, float normalisedValue)
+    {
+        if (parameter.getValue() != normalisedValue)
+            parameter.setValueNotifyingHost(normalisedValue);
+    }
+}
+
+void StateFormat::write(const juce::Array<juce::AudioProcessorParameter*>& parameters, juce::MemoryBlock& destData)
+{
+    juce::MemoryOutputStream out(destData, false);
+
+    int numEntries = 0;
+
+    for (auto* parameter : parameters)
+        if (dynamic_cast<juce::RangedAudioParameter*>(parameter) != nullptr)
+            ++numEntries;
+
+    out.writeInt(static_cast<int>(magic));
+    out.writeShort(static_cast<short>(currentVersion));
+    out.writeShort(static_cast<short>(numEntries));
+
+    for (auto* parameter : parameters)
+    {
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+        {
+            auto idLength = ranged->paramID.getNumBytesAsUTF8();
+            jassert(idLength < 256);
+
+            out.writeByte(static_cast<char>(idLength));
+            out.write(ranged->paramID.toRawUTF8(), idLength);
+            out.writeFloat(ranged->convertFrom0to1(ranged->getValue()));
+        }
+    }
+}
+
+bool StateFormat::read(const void* data, int sizeInBytes, const juce::Array<juce::AudioProcessorParameter*>& parameters)
+{
+    if (data == nullptr || sizeInBytes < headerSize)
+        return false;
+
+    juce::MemoryInputStream in(data, static_cast<size_t>(sizeInBytes), false);
+
+    if (static_cast<juce::uint32>(in.readInt()) != magic)
+        return false;
+
+    // nothing has changed meaning since version 1. Newer versions still load, anything
+    // this build doesn't know about is skipped below.
+    auto version = static_cast<juce::uint16>(in.readShort());
+    auto numEntries = static_cast<int>(static_cast<juce::uint16>(in.readShort()));
+
+    if (version < 1)
+        return false;
+
+    Entry entry;
+
+    for (int i = 0; i < numEntries; ++i)
+        if (!readEntry(in, entry))
+            return false;
+
+    in.setPosition(headerSize);
+
+    juce::BigInteger restored;
+
+    for (int i = 0; i < numEntries; ++i)
+    {
+        readEntry(in, entry);
+
+        int index = 0;
+
+        if (auto* parameter = findParameter(parameters, entry, index))
+        {
+            setIfChanged(*parameter, parameter->convertTo0to1(entry.value));
+            restored.setBit(index);
+        }
+    }
+
+    // anything added since the state was saved starts from its default
+    for (int index = 0; index < parameters.size(); ++index)
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameters.getUnchecked(index)))
+            if (!restored[index])
+                setIfChanged(*ranged, ranged->getDefaultValue());
+
+    return true;
+}
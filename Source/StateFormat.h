@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+    The plugin's saved state: a small versioned binary format instead of XML.
+
+        uint32  magic ("EQst")
+        uint16  format version
+        uint16  number of entries
+        entries: uint8 ID length, ID bytes (UTF-8), float32 value
+
+    Values are stored in real-world units (Hz, dB, choice index) rather than
+    normalised, so a parameter's range can change without breaking old
+    sessions. Unknown IDs are skipped and parameters that aren't in the data
+    go back to their defaults, so parameters can be added and removed freely.
+    Bump the version when an existing ID changes meaning and migrate it in
+    StateFormat::read.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace StateFormat
+{
+    constexpr juce::uint32 magic = 0x74735145; // "EQst" read as little endian
+    constexpr int currentVersion = 1;
+
+    void write(const juce::Array<juce::AudioProcessorParameter*>& parameters, juce::MemoryBlock& destData);
+
+    // checks the whole block first and only then sets the parameters, so a truncated or
+    // foreign block changes nothing and returns false. Doesn't allocate for up to 128 parameters.
+    bool read(const void* data, int sizeInBytes, const juce::Array<juce::AudioProcessorParameter*>& parameters);
+}
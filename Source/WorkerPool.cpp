@@ -0,0 +1,256 @@
+/*
+  ==============================================================================
+    A small pool of pre-spawned threads that the audio thread can hand a batch
+    of independent tasks to, see WorkerPool.h.
+  ==============================================================================
+*/
+#include "WorkerPool.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#else
+ #include <semaphore.h>
+ #include <ctime>
+#endif
+
+namespace
+{
+    // after a job a worker spins this long for the next task of the same block before it parks.
+    // Anything longer would keep a core busy at realtime priority between blocks.
+    constexpr double spinSeconds = 50.0e-6;
+
+    // a parked worker also wakes up this often on its own, so stopping never depends on a post
+    constexpr int parkTimeoutMs = 100;
+}
+
+// a counting semaphore on the OS's own primitive. Posting is a single atomic when nobody is
+// waiting and a futex (or its equivalent) wake when someone is, with no mutex either way,
+// so the audio thread can post to it.
+class WorkerPool::WakeSignal
+{
+public:
+   #if JUCE_WINDOWS
+    WakeSignal() : handle(CreateSemaphoreW(nullptr, 0, maxParticipants * 64, nullptr)) {}
+    ~WakeSignal() { CloseHandle(handle); }
+
+    void post(int count) noexcept { ReleaseSemaphore(handle, count, nullptr); }
+    void wait(int timeoutMs) noexcept { WaitForSingleObject(handle, static_cast<DWORD>(timeoutMs)); }
+
+   private:
+    HANDLE handle;
+   #elif JUCE_MAC || JUCE_IOS
+    WakeSignal() : semaphore(dispatch_semaphore_create(0)) {}
+    ~WakeSignal() { dispatch_release(semaphore); }
+
+    void post(int count) noexcept
+    {
+        for (int i = 0; i < count; ++i)
+            dispatch_semaphore_signal(semaphore);
+    }
+
+    void wait(int timeoutMs) noexcept
+    {
+        dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, static_cast<int64_t>(timeoutMs) * NSEC_PER_MSEC));
+    }
+
+   private:
+    dispatch_semaphore_t semaphore;
+   #else
+    WakeSignal() { sem_init(&semaphore, 0, 0); }
+    ~WakeSignal() { sem_destroy(&semaphore); }
+
+    void post(int count) noexcept
+    {
+        for (int i = 0; i < count; ++i)
+            sem_post(&semaphore);
+    }
+
+    void wait(int timeoutMs) noexcept
+    {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += static_cast<long>(timeoutMs % 1000) * 1000000L;
+        deadline.tv_sec += timeoutMs / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        sem_timedwait(&semaphore, &deadline);
+    }
+
+   private:
+    sem_t semaphore;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE(WakeSignal)
+};
+
+class WorkerPool::Worker : public juce::Thread
+{
+public:
+    Worker(WorkerPool& poolToJoin, int participantIndex)
+        : juce::Thread("EQ worker " + juce::String(participantIndex)), pool(poolToJoin), participant(participantIndex)
+    {
+    }
+
+    ~Worker() override { stopThread(1000); }
+
+private:
+    void run() override
+    {
+        juce::uint32 seen = 0;
+        auto spinTicks = juce::Time::secondsToHighResolutionTicks(spinSeconds);
+        auto lastJob = juce::Time::getHighResolutionTicks();
+
+        while (!threadShouldExit())
+        {
+            auto latest = pool.openJob.load();
+
+            if (latest != 0 && latest != seen)
+            {
+                seen = latest;
+                pool.join(latest, participant);
+                lastJob = juce::Time::getHighResolutionTicks();
+            }
+            else if (juce::Time::getHighResolutionTicks() - lastJob < spinTicks)
+            {
+                juce::Thread::yield();
+            }
+            else
+            {
+                // the count goes up before openJob is looked at again, and run() opens the job
+                // before it reads the count, so one of the two always sees the other
+                ++pool.parkedWorkers;
+
+                latest = pool.openJob.load();
+
+                if (latest == 0 || latest == seen)
+                    pool.wakeSignal->wait(parkTimeoutMs);
+
+                --pool.parkedWorkers;
+            }
+        }
+    }
+
+    WorkerPool& pool;
+    const int participant;
+};
+
+WorkerPool::WorkerPool()
+    : wakeSignal(std::make_unique<WakeSignal>())
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    release();
+}
+
+void WorkerPool::prepare(int numWorkerThreads)
+{
+    release();
+
+    auto numCores = juce::SystemStats::getNumCpus();
+    auto numToStart = juce::jlimit(0, juce::jmin(maxParticipants, numCores) - 1, numWorkerThreads);
+
+    for (int i = 1; i <= numToStart; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+        workers.back()->startThread(juce::Thread::realtimeAudioPriority);
+    }
+}
+
+void WorkerPool::release()
+{
+    for (auto& worker : workers)
+        worker->signalThreadShouldExit();
+
+    // parked workers would otherwise only notice at their next timeout
+    wakeSignal->post(getNumWorkers());
+    workers.clear();
+}
+
+void WorkerPool::run(Job& job, int numTasks) noexcept
+{
+    if (workers.empty() || numTasks < 2)
+    {
+        for (int task = 0; task < numTasks; ++task)
+            job.perform(task, 0);
+
+        return;
+    }
+
+    // contiguous shares, so a participant that's never stolen from works through neighbouring tasks
+    auto numParticipants = getNumParticipants();
+
+    for (int p = 0; p < numParticipants; ++p)
+    {
+        ranges[static_cast<size_t>(p)].next.store(numTasks * p / numParticipants);
+        ranges[static_cast<size_t>(p)].end = numTasks * (p + 1) / numParticipants;
+    }
+
+    currentJob = &job;
+    tasksCompleted.store(0);
+
+    // everything above is in place before the job number tells the workers about it
+    if (++lastJobNumber == 0)
+        ++lastJobNumber;
+
+    openJob.store(lastJobNumber);
+
+    // a post with nobody waiting just leaves a token, which at worst wakes a worker once for nothing
+    auto parked = parkedWorkers.load();
+
+    if (parked > 0)
+        wakeSignal->post(parked);
+
+    performTasks(0);
+
+    // whatever is left has already been claimed by a worker that's running it
+    while (tasksCompleted.load() < numTasks)
+        juce::Thread::yield();
+
+    // a worker that saw the job late may still be looking for tasks, and the ranges and the job
+    // pointer have to stay put until it has given up
+    openJob.store(0);
+
+    while (busyWorkers.load() > 0)
+        juce::Thread::yield();
+
+    currentJob = nullptr;
+}
+
+void WorkerPool::join(juce::uint32 jobNumber, int participant) noexcept
+{
+    // run() can't close the job while busyWorkers is raised, so once the job number checks out
+    // here the ranges belong to that job until this worker is done with them
+    ++busyWorkers;
+
+    if (openJob.load() == jobNumber)
+    {
+        juce::ScopedNoDenormals noDenormals;
+        RealtimeChecks::ScopedAudioThread audioThread;
+        performTasks(participant);
+    }
+
+    --busyWorkers;
+}
+
+void WorkerPool::performTasks(int participant) noexcept
+{
+    auto numParticipants = getNumParticipants();
+
+    for (int offset = 0; offset < numParticipants; ++offset)
+    {
+        auto& range = ranges[static_cast<size_t>((participant + offset) % numParticipants)];
+
+        for (auto task = range.next.fetch_add(1); task < range.end; task = range.next.fetch_add(1))
+        {
+            currentJob->perform(task, participant);
+            ++tasksCompleted;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+    A small pool of pre-spawned threads that the audio thread can hand a batch
+    of independent tasks to. Nothing on the audio thread locks, waits on an
+    event or allocates: a job is published through atomics, the audio thread
+    works on it alongside the workers, and anyone who runs out of tasks
+    steals from the others. Between blocks the workers park on a semaphore,
+    which the audio thread posts to when it opens a job; one that wakes up
+    late simply misses the job and the rest of the participants do its share.
+  ==============================================================================
+*/
+#pragma once
+
+#include <JuceHeader.h>
+#include "RealtimeChecks.h"
+
+class WorkerPool
+{
+public:
+    // a batch of tasks that can run in any order on any thread. participant is 0 for the
+    // thread that called run() and 1..getNumWorkers() for the workers, so a job can keep
+    // one scratch buffer per participant.
+    struct Job
+    {
+        virtual ~Job() = default;
+        virtual void perform(int taskIndex, int participant) noexcept = 0;
+    };
+
+    static constexpr int maxParticipants = 16;
+
+    WorkerPool();
+    ~WorkerPool();
+
+    // starts the threads, so call this from prepareToPlay. 0 stops them all, and the count is
+    // limited to one less than the number of cores, since the audio thread takes part as well
+    void prepare(int numWorkerThreads);
+    void release();
+
+    int getNumWorkers() const noexcept { return static_cast<int>(workers.size()); }
+    int getNumParticipants() const noexcept { return getNumWorkers() + 1; }
+
+    // audio thread: runs every task once and returns when they have all finished. Only one
+    // thread may call this at a time.
+    void run(Job& job, int numTasks) noexcept;
+
+private:
+    class Worker;
+    class WakeSignal;
+
+    void join(juce::uint32 jobNumber, int participant) noexcept;
+    void performTasks(int participant) noexcept;
+
+    // each participant starts on its own share of the tasks and then steals from the others'.
+    // Owner and thieves claim from the same counter, so a task can never run twice.
+    struct alignas(64) TaskRange
+    {
+        std::atomic<int> next{ 0 };
+        int end{ 0 };
+    };
+
+    std::array<TaskRange, maxParticipants> ranges;
+    Job* currentJob{ nullptr };
+
+    // the number of the job that's open for workers to join, 0 while there's none
+    std::atomic<juce::uint32> openJob{ 0 };
+    juce::uint32 lastJobNumber{ 0 };
+    std::atomic<int> tasksCompleted{ 0 }, busyWorkers{ 0 };
+
+    // workers that have stopped spinning and are waiting for run() to post
+    std::atomic<int> parkedWorkers{ 0 };
+    std::unique_ptr<WakeSignal> wakeSignal;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WorkerPool)
+};
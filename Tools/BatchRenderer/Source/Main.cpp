@@ -0,0 +1,411 @@
+/*
+  ==============================================================================
+    Headless batch renderer: runs WAV/FLAC files through EQAudioProcessor
+    (without an editor) as fast as the disks allow, one processor per core.
+
+    BatchRenderer [--settings file.xml] [--set paramID=value ...]
+                  [--match reference.wav] [--match-bands n]
+                  [--output dir] [--block samples] [--threads n] [--float] files/dirs...
+
+    --settings takes either the plugin's saved state (see StateFormat.h) or
+    the parameter tree as XML. With --match every file gets its own
+    spectral match to the reference (see SpectralMatch.h) on top of the
+    settings before it's rendered. The output is lined up with the input,
+    the plugin's latency taken off the front, and carries on for as long
+    as the filters ring. A floating point input is written back as 32-bit
+    float, so whatever the EQ pushes over 0 dBFS survives; integer inputs
+    are written at their own depth (24-bit at most) unless --float asks for
+    float output, which only formats that can store it (WAV) support.
+  ==============================================================================
+*/
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+namespace
+{
+    struct Options
+    {
+        juce::File settingsFile, outputDirectory, matchReference;
+        int matchBands{ 6 };
+        juce::StringPairArray parameterValues;
+        juce::Array<juce::File> inputs;
+        int blockSize{ 65536 };
+        int numThreads{ juce::SystemStats::getNumCpus() };
+        bool floatOutput{ false };
+    };
+
+    void printUsage()
+    {
+        std::cout << "usage: BatchRenderer [--settings file.xml] [--set paramID=value ...]" << std::endl
+                  << "                     [--match reference.wav] [--match-bands n]" << std::endl
+                  << "                     [--output dir] [--block samples] [--threads n] [--float] files/dirs..." << std::endl;
+    }
+
+    bool parseOptions(const juce::ArgumentList& args, Options& options)
+    {
+        for (int i = 0; i < args.size(); ++i)
+        {
+            auto arg = args[i].text;
+            auto hasValue = i + 1 < args.size();
+
+            if (arg == "--settings" && hasValue)    options.settingsFile = args[++i].resolveAsFile();
+            else if (arg == "--output" && hasValue) options.outputDirectory = args[++i].resolveAsFile();
+            else if (arg == "--match" && hasValue)  options.matchReference = args[++i].resolveAsFile();
+            else if (arg == "--match-bands" && hasValue) options.matchBands = juce::jlimit(0, maxBands, args[++i].text.getIntValue());
+            else if (arg == "--block" && hasValue)  options.blockSize = juce::jmax(64, args[++i].text.getIntValue());
+            else if (arg == "--threads" && hasValue) options.numThreads = juce::jmax(1, args[++i].text.getIntValue());
+            else if (arg == "--float") options.floatOutput = true;
+            else if (arg == "--set" && hasValue)
+            {
+                auto assignment = args[++i].text;
+                options.parameterValues.set(assignment.upToFirstOccurrenceOf("=", false, false),
+                                            assignment.fromFirstOccurrenceOf("=", false, false));
+            }
+            else if (arg.startsWith("--"))
+            {
+                return false;
+            }
+            else
+            {
+                auto file = args[i].resolveAsFile();
+
+                if (file.isDirectory())
+                    for (auto& f : file.findChildFiles(juce::File::findFiles, true, "*.wav;*.flac"))
+                        options.inputs.add(f);
+                else
+                    options.inputs.add(file);
+            }
+        }
+
+        return !options.inputs.isEmpty();
+    }
+
+    // puts the settings file and any --set overrides into a processor
+    bool applySettings(EQAudioProcessor& processor, const Options& options)
+    {
+        if (options.settingsFile != juce::File())
+        {
+            juce::MemoryBlock data;
+            options.settingsFile.loadFileAsData(data);
+
+            // what the plugin saves starts with StateFormat's magic, anything else has to be XML
+            auto isState = data.getSize() >= sizeof(juce::uint32)
+                        && juce::ByteOrder::littleEndianInt(data.getData()) == StateFormat::magic;
+
+            if (isState)
+            {
+                processor.setStateInformation(data.getData(), static_cast<int>(data.getSize()));
+            }
+            else
+            {
+                auto xml = juce::parseXML(data.toString());
+
+                if (xml == nullptr || !xml->hasTagName(processor.apvts.state.getType()))
+                {
+                    std::cerr << "couldn't read settings from " << options.settingsFile.getFullPathName() << std::endl;
+                    return false;
+                }
+
+                processor.apvts.replaceState(juce::ValueTree::fromXml(*xml));
+            }
+        }
+
+        for (auto& key : options.parameterValues.getAllKeys())
+        {
+            auto* parameter = processor.apvts.getParameter(key);
+
+            if (parameter == nullptr)
+            {
+                std::cerr << "unknown parameter " << key << std::endl;
+                return false;
+            }
+
+            auto value = options.parameterValues[key].getFloatValue();
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        }
+
+        return true;
+    }
+
+    // the parameters are only ever set on the message thread, the way a host does it, so a worker
+    // hands the change over and waits until it's been made. main() runs the dispatch loop.
+    void callOnMessageThread(std::function<void()> function)
+    {
+        juce::WaitableEvent done;
+
+        juce::MessageManager::callAsync([&function, &done]
+        {
+            function();
+            done.signal();
+        });
+
+        done.wait();
+    }
+
+    //==============================================================================
+    class FileRenderer
+    {
+    public:
+        FileRenderer(int blockSize, bool alwaysWriteFloat)
+            : samplesPerBlock(blockSize), writeFloat(alwaysWriteFloat)
+        {
+            // every renderer has its own formats, AudioFormatManager isn't safe to share between
+            // threads, and decodes on its own read-ahead thread, one shared thread would put all
+            // the FLAC decoding on a single core
+            formatManager.registerBasicFormats();
+            readAhead.startThread();
+        }
+
+        EQAudioProcessor processor;
+
+        // set when every file should be matched to this before it's rendered
+        const SpectralMatch::Spectrum* matchReference{ nullptr };
+        int matchBands{ 0 };
+
+        // message thread, once the settings and overrides are in: every file's match starts from
+        // these, and they're put back after each matched file so nothing carries over to the next
+        void keepBaseSettings()
+        {
+            baseSettings = processor.getChainSettings();
+            processor.getStateInformation(baseState);
+        }
+
+        bool render(const juce::File& input, const juce::File& output)
+        {
+            auto reader = createReader(input);
+
+            if (reader == nullptr)
+                return fail("couldn't open " + input.getFullPathName());
+
+            auto numChannels = static_cast<int>(reader->numChannels);
+            auto sampleRate = reader->sampleRate;
+
+            // the bus has to match the file, the filter engine is sized from it in prepareToPlay
+            auto channels = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+            if (channels.isDisabled())
+                channels = juce::AudioChannelSet::discreteChannels(numChannels);
+
+            // only the main buses change, the sidechain stays switched off
+            auto layout = processor.getBusesLayout();
+            layout.inputBuses.getReference(0) = channels;
+            layout.outputBuses.getReference(0) = channels;
+
+            if (!processor.setBusesLayout(layout))
+                return fail("unsupported channel count in " + input.getFullPathName());
+
+            // analysed and fitted on this thread, every other core already has a file of its own
+            if (matchReference != nullptr)
+            {
+                auto material = SpectralMatch::analyseFile(formatManager, input, 1);
+
+                if (!material.isValid())
+                    return fail("couldn't analyse " + input.getFullPathName());
+
+                auto matched = SpectralMatch::fit(*matchReference, material, matchBands, baseSettings);
+                callOnMessageThread([this, &matched] { processor.applySettings(matched, matchBands); });
+            }
+
+            auto rendered = renderPrepared(input, output, *reader, numChannels, sampleRate);
+
+            if (matchReference != nullptr)
+                callOnMessageThread([this] { processor.setStateInformation(baseState.getData(), static_cast<int>(baseState.getSize())); });
+
+            return rendered;
+        }
+
+    private:
+        bool renderPrepared(const juce::File& input, const juce::File& output, juce::AudioFormatReader& reader,
+                            int numChannels, double sampleRate)
+        {
+            processor.setNonRealtime(true);
+            processor.setRateAndBufferSizeDetails(sampleRate, samplesPerBlock);
+            processor.prepareToPlay(sampleRate, samplesPerBlock);
+
+            // in linear phase mode the kernel is still loading in the background at this point
+            if (!processor.waitUntilReadyToRender(10000))
+                return fail("timed out waiting for the linear phase kernel for " + input.getFullPathName());
+
+            auto* format = formatManager.findFormatForFileExtension(output.getFileExtension());
+
+            // float stays float, anything the EQ boosts past full scale would clip as integer
+            auto floatOutput = reader.usesFloatingPointData || writeFloat;
+            auto bitsPerSample = floatOutput ? 32 : juce::jmin(static_cast<int>(reader.bitsPerSample), 24);
+
+            if (format != nullptr && !format->getPossibleBitDepths().contains(bitsPerSample))
+                return fail(format->getFormatName() + " can't store " + juce::String(bitsPerSample) + "-bit "
+                            + (floatOutput ? "float" : "integer") + " samples for " + output.getFullPathName());
+
+            output.deleteFile();
+            auto stream = std::make_unique<juce::FileOutputStream>(output);
+
+            std::unique_ptr<juce::AudioFormatWriter> writer;
+            if (format != nullptr && stream->openedOk())
+                writer.reset(format->createWriterFor(stream.get(), sampleRate, static_cast<unsigned int>(numChannels), bitsPerSample, {}, 0));
+
+            if (writer == nullptr)
+                return fail("couldn't write " + output.getFullPathName());
+
+            stream.release(); // the writer owns the stream now
+
+            buffer.setSize(numChannels, samplesPerBlock, false, false, true);
+
+            // the tail covers the latency as well, so silence is fed in for that long after the file,
+            // and the first latency samples that come out are thrown away
+            auto latency = static_cast<juce::int64>(processor.getLatencySamples());
+            auto tail = juce::jmax(latency, static_cast<juce::int64>(std::ceil(processor.getTailLengthSeconds() * sampleRate)));
+            auto totalSamples = reader.lengthInSamples + tail;
+            auto samplesToDiscard = latency;
+
+            for (juce::int64 position = 0; position < totalSamples; position += samplesPerBlock)
+            {
+                auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(samplesPerBlock), totalSamples - position));
+
+                // the reader fills anything past the end of the file with silence
+                buffer.setSize(numChannels, numSamples, false, false, true);
+                reader.read(&buffer, 0, numSamples, position, true, true);
+
+                processor.processBlock(buffer, midi);
+
+                auto skip = static_cast<int>(juce::jmin(samplesToDiscard, static_cast<juce::int64>(numSamples)));
+                samplesToDiscard -= skip;
+
+                writer->writeFromAudioSampleBuffer(buffer, skip, numSamples - skip);
+            }
+
+            processor.releaseResources();
+            return true;
+        }
+
+        std::unique_ptr<juce::AudioFormatReader> createReader(const juce::File& file)
+        {
+            // WAVs are memory-mapped so the OS pages them in for us,
+            // anything else gets a read-ahead buffer filled on a background thread
+            if (file.hasFileExtension("wav"))
+            {
+                juce::WavAudioFormat wav;
+                std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(wav.createMemoryMappedReader(file));
+
+                if (mapped != nullptr && mapped->mapEntireFile())
+                    return mapped;
+            }
+
+            if (auto* reader = formatManager.createReaderFor(file))
+            {
+                auto buffered = std::make_unique<juce::BufferingAudioReader>(reader, readAhead, samplesPerBlock * 4);
+                buffered->setReadTimeout(-1); // offline, so wait for the data rather than returning silence
+                return buffered;
+            }
+
+            return {};
+        }
+
+        bool fail(const juce::String& message)
+        {
+            std::cerr << message << std::endl;
+            return false;
+        }
+
+        juce::AudioFormatManager formatManager;
+        juce::TimeSliceThread readAhead{ "EQ batch read-ahead" };
+        int samplesPerBlock;
+        bool writeFloat;
+
+        chainsettings baseSettings;
+        juce::MemoryBlock baseState;
+
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+    };
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+    Options options;
+
+    if (!parseOptions(args, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    // the reference is analysed once, on every core, before anything is rendered
+    SpectralMatch::Spectrum matchReference;
+
+    if (options.matchReference != juce::File())
+    {
+        matchReference = SpectralMatch::analyseFile(formatManager, options.matchReference, juce::SystemStats::getNumCpus());
+
+        if (!matchReference.isValid())
+        {
+            std::cerr << "couldn't analyse " << options.matchReference.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    // one processor per worker, all made here on the message thread
+    auto numWorkers = juce::jmin(options.numThreads, options.inputs.size());
+    juce::OwnedArray<FileRenderer> renderers;
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        auto* renderer = renderers.add(new FileRenderer(options.blockSize, options.floatOutput));
+
+        if (!applySettings(renderer->processor, options))
+            return 1;
+
+        renderer->keepBaseSettings();
+
+        if (matchReference.isValid())
+        {
+            renderer->matchReference = &matchReference;
+            renderer->matchBands = options.matchBands;
+        }
+    }
+
+    std::atomic<int> nextFile{ 0 }, numFailed{ 0 };
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    // the workers run on their own threads, so this one is free to be the message thread that
+    // the processors' parameter changes go through
+    juce::Thread::launch([&renderers, &options, &nextFile, &numFailed, numWorkers]
+    {
+        juce::ThreadPool pool(numWorkers);
+
+        for (auto* renderer : renderers)
+        {
+            pool.addJob([renderer, &options, &nextFile, &numFailed]
+            {
+                for (auto index = nextFile++; index < options.inputs.size(); index = nextFile++)
+                {
+                    auto input = options.inputs[index];
+                    auto directory = options.outputDirectory == juce::File() ? input.getParentDirectory() : options.outputDirectory;
+                    auto output = directory.getChildFile(input.getFileNameWithoutExtension() + "_eq" + input.getFileExtension());
+
+                    if (!renderer->render(input, output))
+                        ++numFailed;
+                }
+            });
+        }
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep(50);
+
+        juce::MessageManager::getInstance()->stopDispatchLoop();
+    });
+
+    juce::MessageManager::getInstance()->runDispatchLoop();
+
+    auto seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+    std::cout << "rendered " << options.inputs.size() - numFailed.load() << " of " << options.inputs.size()
+              << " files in " << seconds << " s on " << numWorkers << " threads" << std::endl;
+
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,460 @@
+/*
+  ==============================================================================
+    DSP micro-benchmark: drives EQAudioProcessor::processBlock headlessly over
+    block sizes, sample rates, cut slopes and static/automated parameters, in
+    both float and double precision, and prints the results as JSON so runs
+    from two commits can be compared.
+    --restore times setStateInformation over many prepared instances instead,
+    the way a large session loads, and fails (exit code 1) unless every
+    instance gets the settings, has them designed exactly once and, in the
+    timing build, the whole restore fits in --restore-budget ms (1000 by
+    default, for the default 1,000 instances).
+    --bands times the cascade with more and more of the extra bands switched
+    on, which should cost the same for every band added.
+    --workers gives the processor that many worker threads for wide buses,
+    --tile overrides the cache tile size the cascade picks for long blocks.
+
+    The Release build times the plugin as it ships. The Allocations build
+    (BenchmarkAllocations) has EQ_REALTIME_CHECKS on, which intercepts malloc
+    and friends, and runs the same cases to count what they allocate instead.
+    Its times include the interception, so it reports the counts and no times.
+
+    Benchmark [--seconds=s] [--channels=n] [--workers=n] [--tile=samples] [--label=name] [--output=file.json]
+    Benchmark --bands [--seconds=s] [--channels=n] [--workers=n] [--tile=samples] [--label=name] [--output=file.json]
+    Benchmark --restore[=instances] [--restore-budget=ms] [--label=name] [--output=file.json]
+  ==============================================================================
+*/
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace
+{
+    // only the Allocations build can count, see the top of this file
+    constexpr bool countingAllocations = EQ_REALTIME_CHECKS != 0;
+
+    juce::uint64 readCycleCounter() noexcept
+    {
+       #if JUCE_INTEL
+        return __rdtsc();
+       #else
+        return 0; // no portable cycle counter, cycles are estimated from the clock speed below
+       #endif
+    }
+
+    struct Options
+    {
+        double secondsPerRun{ 0.25 };
+        int numChannels{ 2 };
+        int numWorkerThreads{ 0 };
+        int tileSize{ 0 };
+        juce::String label;
+        juce::File outputFile;
+        int restoreInstances{ 0 };
+        double restoreBudgetMs{ 1000.0 };
+        bool bandSweep{ false };
+    };
+
+    struct Result
+    {
+        double nsPerSample{ 0 }, cyclesPerSample{ 0 }, allocationsPerBlock{ 0 };
+    };
+
+    // moves the continuous parameters along a slow sweep, like host automation would
+    void automate(EQAudioProcessor& processor, int blockIndex)
+    {
+        auto phase = static_cast<float>(blockIndex % 512) / 512.f;
+        auto wave = 0.5f + 0.5f * std::sin(juce::MathConstants<float>::twoPi * phase);
+
+        for (auto* id : { "PeakFreq", "peakGain", "peakQuality", "lowcutFreq", "highcutFreq" })
+            processor.apvts.getParameter(id)->setValueNotifyingHost(wave);
+    }
+
+    void setValue(EQAudioProcessor& processor, const char* id, float value)
+    {
+        auto* parameter = processor.apvts.getParameter(id);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    void setChoice(EQAudioProcessor& processor, const char* id, int index)
+    {
+        setValue(processor, id, static_cast<float>(index));
+    }
+
+    template <typename SampleType>
+    Result run(EQAudioProcessor& processor, const Options& options, double sampleRate, int blockSize, bool automated)
+    {
+        // a host picks the precision before preparing, the processor only sets up that path
+        processor.setProcessingPrecision(std::is_same<SampleType, double>::value ? juce::AudioProcessor::doublePrecision
+                                                                                : juce::AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        juce::AudioBuffer<SampleType> buffer(options.numChannels, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random(1234);
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                buffer.setSample(ch, i, static_cast<SampleType>(random.nextFloat() * 0.5f - 0.25f));
+
+        auto numBlocks = juce::jmax(8, static_cast<int>(options.secondsPerRun * sampleRate / blockSize));
+
+        // let the designer thread hand over its first set before timing anything
+        for (int i = 0; i < 4; ++i)
+            processor.processBlock(buffer, midi);
+
+        juce::int64 ticks = 0;
+        juce::uint64 cycles = 0;
+
+        // in the Allocations build processBlock counts what it allocates through RealtimeChecks
+        RealtimeChecks::resetCounts();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            if (automated)
+                automate(processor, block);
+
+            auto startCycles = readCycleCounter();
+            auto startTicks = juce::Time::getHighResolutionTicks();
+
+            processor.processBlock(buffer, midi);
+
+            ticks += juce::Time::getHighResolutionTicks() - startTicks;
+            cycles += readCycleCounter() - startCycles;
+        }
+
+        processor.releaseResources();
+
+        auto totalSamples = static_cast<double>(numBlocks) * blockSize;
+        auto nanoseconds = juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9;
+
+        Result result;
+        result.nsPerSample = nanoseconds / totalSamples;
+        result.cyclesPerSample = cycles != 0 ? static_cast<double>(cycles) / totalSamples
+                                             : result.nsPerSample * juce::SystemStats::getCpuSpeedInMegahertz() / 1000.0;
+        result.allocationsPerBlock = static_cast<double>(RealtimeChecks::getSummary().numAllocations) / numBlocks;
+        return result;
+    }
+
+    juce::var toVar(const Result& result)
+    {
+        auto* object = new juce::DynamicObject();
+
+        if (countingAllocations)
+        {
+            object->setProperty("allocationsPerBlock", result.allocationsPerBlock);
+        }
+        else
+        {
+            object->setProperty("nsPerSample", result.nsPerSample);
+            object->setProperty("cyclesPerSample", result.cyclesPerSample);
+        }
+
+        return object;
+    }
+
+    juce::var runMatrix(const Options& options)
+    {
+        const int blockSizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 16384, 65536 };
+        const double sampleRates[] = { 44100.0, 48000.0, 96000.0, 192000.0, 384000.0 };
+
+        EQAudioProcessor processor;
+        processor.setNumWorkerThreads(options.numWorkerThreads);
+        processor.setTileSize(options.tileSize);
+
+        auto layout = processor.getBusesLayout();
+        layout.inputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(options.numChannels);
+        layout.outputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(options.numChannels);
+        processor.setBusesLayout(layout);
+
+        juce::Array<juce::var> runs;
+
+        for (auto sampleRate : sampleRates)
+        {
+            for (auto blockSize : blockSizes)
+            {
+                for (int lowSlope = Slope1; lowSlope <= Slope4; ++lowSlope)
+                {
+                    for (int highSlope = Slope1; highSlope <= Slope4; ++highSlope)
+                    {
+                        for (auto automated : { false, true })
+                        {
+                            // start every run from the same settings, with the cuts somewhere audible
+                            setValue(processor, "lowcutFreq", 80.f);
+                            setValue(processor, "highcutFreq", 12000.f);
+                            setValue(processor, "peakGain", 6.f);
+                            setChoice(processor, "lowcutSlope", lowSlope);
+                            setChoice(processor, "highcutSlope", highSlope);
+
+                            auto* entry = new juce::DynamicObject();
+                            entry->setProperty("sampleRate", sampleRate);
+                            entry->setProperty("blockSize", blockSize);
+                            entry->setProperty("lowCutSlope", (lowSlope + 1) * 12);
+                            entry->setProperty("highCutSlope", (highSlope + 1) * 12);
+                            entry->setProperty("automated", automated);
+                            entry->setProperty("float", toVar(run<float>(processor, options, sampleRate, blockSize, automated)));
+                            entry->setProperty("double", toVar(run<double>(processor, options, sampleRate, blockSize, automated)));
+
+                            runs.add(entry);
+                        }
+                    }
+                }
+            }
+
+            std::cerr << "finished " << sampleRate << " Hz" << std::endl;
+        }
+
+        return runs;
+    }
+
+    // the same block over and over with 0, 4, 8... peak bands on, spread over the spectrum
+    juce::var runBands(const Options& options)
+    {
+        EQAudioProcessor processor;
+        processor.setNumWorkerThreads(options.numWorkerThreads);
+        processor.setTileSize(options.tileSize);
+
+        auto layout = processor.getBusesLayout();
+        layout.inputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(options.numChannels);
+        layout.outputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(options.numChannels);
+        processor.setBusesLayout(layout);
+
+        juce::Array<juce::var> runs;
+
+        for (int numBands = 0; numBands <= maxBands; numBands += 4)
+        {
+            for (int i = 0; i < maxBands; ++i)
+            {
+                setChoice(processor, ChainParameters::getBandParameterID(i, "Type").toRawUTF8(), i < numBands ? BandPeak : BandOff);
+                setValue(processor, ChainParameters::getBandParameterID(i, "Gain").toRawUTF8(), i % 2 == 0 ? 3.f : -3.f);
+            }
+
+            auto* entry = new juce::DynamicObject();
+            entry->setProperty("bands", numBands);
+            entry->setProperty("float", toVar(run<float>(processor, options, 48000.0, 512, false)));
+            runs.add(entry);
+        }
+
+        return runs;
+    }
+
+    // builds one state with every parameter away from its default, then restores it into
+    // restoreInstances prepared processors, the way a large session loads. This is a test as
+    // well as a timing: every instance has to end up with the restored settings, designed
+    // exactly once, and the timing build has to restore them all within restoreBudgetMs.
+    juce::var runRestore(const Options& options, bool& passed)
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int blockSize = 128;
+        constexpr float restoredGain = 6.f;
+
+        juce::MemoryBlock state;
+
+        {
+            EQAudioProcessor source;
+            setValue(source, "lowcutFreq", 80.f);
+            setValue(source, "highcutFreq", 12000.f);
+            setValue(source, "PeakFreq", 2500.f);
+            setValue(source, "peakGain", restoredGain);
+            setValue(source, "peakQuality", 2.f);
+            setChoice(source, "lowcutSlope", Slope3);
+            setChoice(source, "highcutSlope", Slope2);
+            source.getStateInformation(state);
+        }
+
+        std::vector<std::unique_ptr<EQAudioProcessor>> processors;
+        processors.reserve(static_cast<size_t>(options.restoreInstances));
+
+        auto constructStart = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < options.restoreInstances; ++i)
+            processors.push_back(std::make_unique<EQAudioProcessor>());
+
+        // prepared like a host would before the session's state arrives, which designs the defaults once
+        for (auto& processor : processors)
+        {
+            processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+            processor->prepareToPlay(sampleRate, blockSize);
+        }
+
+        std::vector<int> designsBefore;
+
+        for (auto& processor : processors)
+            designsBefore.push_back(processor->getNumCoefficientDesigns());
+
+        auto restoreStart = juce::Time::getHighResolutionTicks();
+
+        for (auto& processor : processors)
+            processor->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+
+        auto restoreEnd = juce::Time::getHighResolutionTicks();
+
+        // the designer thread picks the restores up within a few ms. Once every instance has had
+        // its design, it's given a while longer to make sure no second one follows.
+        auto countDesigns = [&](int& fewest, int& most)
+        {
+            fewest = std::numeric_limits<int>::max();
+            most = 0;
+
+            for (size_t i = 0; i < processors.size(); ++i)
+            {
+                auto designs = processors[i]->getNumCoefficientDesigns() - designsBefore[i];
+                fewest = juce::jmin(fewest, designs);
+                most = juce::jmax(most, designs);
+            }
+        };
+
+        int fewestDesigns = 0, mostDesigns = 0;
+
+        for (auto waitStart = juce::Time::getMillisecondCounter(); juce::Time::getMillisecondCounter() - waitStart < 5000;)
+        {
+            countDesigns(fewestDesigns, mostDesigns);
+
+            if (fewestDesigns >= 1)
+                break;
+
+            juce::Thread::sleep(5);
+        }
+
+        juce::Thread::sleep(100);
+        countDesigns(fewestDesigns, mostDesigns);
+
+        auto settingsRestored = std::all_of(processors.begin(), processors.end(), [&](const std::unique_ptr<EQAudioProcessor>& processor)
+        {
+            return std::abs(processor->getChainSettings().peakGain - restoredGain) <= 0.01f;
+        });
+
+        // the Allocations build counts one more restore on its own, after the design check
+        juce::int64 restoreAllocations = 0;
+
+        if (countingAllocations)
+        {
+            RealtimeChecks::resetCounts();
+
+            {
+                RealtimeChecks::ScopedAudioThread countAllocations;
+                processors.front()->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+            }
+
+            restoreAllocations = RealtimeChecks::getSummary().numAllocations;
+        }
+
+        for (auto& processor : processors)
+            processor->releaseResources();
+
+        auto restoreMs = juce::Time::highResolutionTicksToSeconds(restoreEnd - restoreStart) * 1000.0;
+        auto designedOnce = fewestDesigns == 1 && mostDesigns == 1;
+        auto withinBudget = countingAllocations || restoreMs <= options.restoreBudgetMs;
+
+        if (!settingsRestored)
+            std::cerr << "restore failed: not every instance has the restored settings" << std::endl;
+
+        if (!designedOnce)
+            std::cerr << "restore failed: instances designed between " << fewestDesigns << " and " << mostDesigns
+                      << " times after the restore, rather than once" << std::endl;
+
+        if (!withinBudget)
+            std::cerr << "restore failed: " << restoreMs << " ms for " << options.restoreInstances
+                      << " instances, the budget is " << options.restoreBudgetMs << " ms" << std::endl;
+
+        passed = settingsRestored && designedOnce && withinBudget;
+
+        auto toMsPerInstance = [&](juce::int64 ticks)
+        {
+            return juce::Time::highResolutionTicksToSeconds(ticks) * 1000.0 / juce::jmax(1, options.restoreInstances);
+        };
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("instances", options.restoreInstances);
+        result->setProperty("stateBytes", static_cast<int>(state.getSize()));
+
+        if (countingAllocations)
+        {
+            result->setProperty("restoreAllocationsPerInstance", static_cast<double>(restoreAllocations));
+        }
+        else
+        {
+            result->setProperty("constructMsPerInstance", toMsPerInstance(restoreStart - constructStart));
+            result->setProperty("restoreMsPerInstance", toMsPerInstance(restoreEnd - restoreStart));
+            result->setProperty("restoreMs", restoreMs);
+            result->setProperty("restoreBudgetMs", options.restoreBudgetMs);
+        }
+
+        result->setProperty("designsPerInstance", mostDesigns);
+        result->setProperty("restoreOk", passed);
+        return result;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+    Options options;
+
+    if (args.containsOption("--seconds"))  options.secondsPerRun = args.getValueForOption("--seconds").getDoubleValue();
+    if (args.containsOption("--channels")) options.numChannels = juce::jmax(1, args.getValueForOption("--channels").getIntValue());
+    if (args.containsOption("--workers"))  options.numWorkerThreads = juce::jmax(0, args.getValueForOption("--workers").getIntValue());
+    if (args.containsOption("--tile"))     options.tileSize = juce::jmax(0, args.getValueForOption("--tile").getIntValue());
+    if (args.containsOption("--label"))    options.label = args.getValueForOption("--label");
+    if (args.containsOption("--output"))   options.outputFile = args.getFileForOption("--output");
+    if (args.containsOption("--bands"))    options.bandSweep = true;
+
+    if (args.containsOption("--restore"))
+    {
+        // --restore on its own means 1,000 instances
+        auto instances = args.getValueForOption("--restore");
+        options.restoreInstances = instances.isEmpty() ? 1000 : juce::jmax(1, instances.getIntValue());
+    }
+
+    if (args.containsOption("--restore-budget"))
+        options.restoreBudgetMs = args.getValueForOption("--restore-budget").getDoubleValue();
+
+    auto passed = true;
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("label", options.label);
+    report->setProperty("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty("build", countingAllocations ? "allocations" : "timing");
+
+    if (options.restoreInstances > 0)
+    {
+        report->setProperty("restore", runRestore(options, passed));
+    }
+    else if (options.bandSweep)
+    {
+        report->setProperty("channels", options.numChannels);
+        report->setProperty("workers", options.numWorkerThreads);
+        report->setProperty("tileSize", options.tileSize);
+        report->setProperty("secondsPerRun", options.secondsPerRun);
+        report->setProperty("bands", runBands(options));
+    }
+    else
+    {
+        report->setProperty("channels", options.numChannels);
+        report->setProperty("workers", options.numWorkerThreads);
+        report->setProperty("tileSize", options.tileSize);
+        report->setProperty("secondsPerRun", options.secondsPerRun);
+        report->setProperty("runs", runMatrix(options));
+    }
+
+    auto json = juce::JSON::toString(juce::var(report));
+
+    if (options.outputFile != juce::File())
+        options.outputFile.replaceWithText(json);
+    else
+        std::cout << json << std::endl;
+
+    // --restore is a test as well, a failed check fails the run
+    return passed ? 0 : 1;
+}
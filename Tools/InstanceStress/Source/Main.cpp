@@ -0,0 +1,265 @@
+/*
+  ==============================================================================
+    Many-instance stress harness: for each instance count N it constructs N
+    EQAudioProcessors, prepares them, runs them all one after another over a
+    stretch of audio (the way a host runs a session's plugins on one core) and
+    opens a few editors. It reports construction and prepareToPlay time, the
+    resident memory each instance adds, editor-open latency and the CPU time
+    per second of audio, as JSON, so servers can be budgeted from it.
+
+    InstanceStress [--instances=1,10,100,500,1000,2000] [--seconds=s] [--channels=n]
+                   [--block=samples] [--editors=n] [--label=name] [--output=file.json]
+  ==============================================================================
+*/
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+ #include <psapi.h>
+ #pragma comment(lib, "psapi.lib")
+#elif JUCE_MAC
+ #include <mach/mach.h>
+ #include <sys/resource.h>
+#else
+ #include <sys/resource.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+    struct Options
+    {
+        juce::Array<int> instanceCounts{ 1, 10, 100, 500, 1000, 2000 };
+        double secondsOfAudio{ 1.0 };
+        int numChannels{ 2 };
+        int blockSize{ 512 };
+        int numEditors{ 8 };
+        juce::String label;
+        juce::File outputFile;
+    };
+
+    constexpr double sampleRate = 48000.0;
+
+    // the process's resident set, which is what a server actually runs out of
+    juce::int64 getResidentBytes()
+    {
+       #if JUCE_WINDOWS
+        PROCESS_MEMORY_COUNTERS counters{};
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return static_cast<juce::int64>(counters.WorkingSetSize);
+       #elif JUCE_MAC
+        mach_task_basic_info_data_t info{};
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count);
+        return static_cast<juce::int64>(info.resident_size);
+       #else
+        auto fields = juce::StringArray::fromTokens(juce::File("/proc/self/statm").loadFileAsString(), false);
+        return fields.size() > 1 ? fields[1].getLargeIntValue() * sysconf(_SC_PAGESIZE) : 0;
+       #endif
+    }
+
+    // user plus system time of the whole process, so the designer and editor threads count too
+    double getProcessCpuSeconds()
+    {
+       #if JUCE_WINDOWS
+        FILETIME created, exited, kernel, user;
+        GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+
+        auto toSeconds = [](const FILETIME& time)
+        {
+            return static_cast<double>((static_cast<juce::uint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1.0e-7;
+        };
+
+        return toSeconds(kernel) + toSeconds(user);
+       #else
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+
+        auto toSeconds = [](const timeval& time) { return static_cast<double>(time.tv_sec) + time.tv_usec * 1.0e-6; };
+        return toSeconds(usage.ru_utime) + toSeconds(usage.ru_stime);
+       #endif
+    }
+
+    double ticksToMs(juce::int64 ticks)
+    {
+        return juce::Time::highResolutionTicksToSeconds(ticks) * 1000.0;
+    }
+
+    void setValue(EQAudioProcessor& processor, const char* id, float value)
+    {
+        auto* parameter = processor.apvts.getParameter(id);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    juce::var runInstances(const Options& options, int numInstances)
+    {
+        std::vector<std::unique_ptr<EQAudioProcessor>> processors;
+        processors.reserve(static_cast<size_t>(numInstances));
+
+        auto residentBefore = getResidentBytes();
+        auto constructStart = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numInstances; ++i)
+        {
+            processors.push_back(std::make_unique<EQAudioProcessor>());
+
+            auto& processor = *processors.back();
+            auto layout = processor.getBusesLayout();
+            layout.inputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(options.numChannels);
+            layout.outputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(options.numChannels);
+            processor.setBusesLayout(layout);
+        }
+
+        auto constructEnd = juce::Time::getHighResolutionTicks();
+        auto residentConstructed = getResidentBytes();
+
+        for (auto& processor : processors)
+        {
+            // something audible in every stage, so each instance does real work
+            setValue(*processor, "lowcutFreq", 80.f);
+            setValue(*processor, "highcutFreq", 12000.f);
+            setValue(*processor, "peakGain", 6.f);
+            processor->setRateAndBufferSizeDetails(sampleRate, options.blockSize);
+        }
+
+        auto prepareStart = juce::Time::getHighResolutionTicks();
+
+        for (auto& processor : processors)
+            processor->prepareToPlay(sampleRate, options.blockSize);
+
+        auto prepareEnd = juce::Time::getHighResolutionTicks();
+        auto residentPrepared = getResidentBytes();
+
+        // every instance gets its own buffer, like separate tracks
+        juce::Random random(1234);
+        std::vector<juce::AudioBuffer<float>> buffers;
+        buffers.reserve(processors.size());
+
+        for (size_t i = 0; i < processors.size(); ++i)
+        {
+            buffers.emplace_back(options.numChannels, options.blockSize);
+
+            for (int ch = 0; ch < options.numChannels; ++ch)
+                for (int s = 0; s < options.blockSize; ++s)
+                    buffers.back().setSample(ch, s, random.nextFloat() * 0.5f - 0.25f);
+        }
+
+        juce::MidiBuffer midi;
+        auto numBlocks = juce::jmax(1, static_cast<int>(options.secondsOfAudio * sampleRate / options.blockSize));
+        auto audioSeconds = static_cast<double>(numBlocks) * options.blockSize / sampleRate;
+
+        auto cpuStart = getProcessCpuSeconds();
+        auto processStart = juce::Time::getHighResolutionTicks();
+        juce::int64 worstBlockTicks = 0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            auto blockStart = juce::Time::getHighResolutionTicks();
+
+            for (size_t i = 0; i < processors.size(); ++i)
+                processors[i]->processBlock(buffers[i], midi);
+
+            worstBlockTicks = juce::jmax(worstBlockTicks, juce::Time::getHighResolutionTicks() - blockStart);
+        }
+
+        auto processEnd = juce::Time::getHighResolutionTicks();
+        auto cpuSeconds = getProcessCpuSeconds() - cpuStart;
+
+        // editors are opened and closed one at a time, only a few of them, since nobody has two
+        // thousand open at once. Without a window this is construction only, nothing gets painted.
+        auto numEditors = juce::jmin(options.numEditors, numInstances);
+        juce::int64 editorTicks = 0;
+        juce::int64 editorBytes = 0;
+
+        for (int i = 0; i < numEditors; ++i)
+        {
+            auto residentBeforeEditor = getResidentBytes();
+            auto editorStart = juce::Time::getHighResolutionTicks();
+
+            std::unique_ptr<juce::AudioProcessorEditor> editor(processors[static_cast<size_t>(i)]->createEditorAndMakeActive());
+
+            editorTicks += juce::Time::getHighResolutionTicks() - editorStart;
+            editorBytes += getResidentBytes() - residentBeforeEditor;
+        }
+
+        auto blockBudgetTicks = juce::Time::secondsToHighResolutionTicks(options.blockSize / sampleRate);
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("instances", numInstances);
+        result->setProperty("constructMsPerInstance", ticksToMs(constructEnd - constructStart) / numInstances);
+        result->setProperty("prepareMsPerInstance", ticksToMs(prepareEnd - prepareStart) / numInstances);
+        result->setProperty("constructedBytesPerInstance", static_cast<double>(residentConstructed - residentBefore) / numInstances);
+        result->setProperty("preparedBytesPerInstance", static_cast<double>(residentPrepared - residentBefore) / numInstances);
+        result->setProperty("editorOpenMs", numEditors > 0 ? ticksToMs(editorTicks) / numEditors : 0.0);
+        result->setProperty("editorBytes", numEditors > 0 ? static_cast<double>(editorBytes) / numEditors : 0.0);
+        result->setProperty("cpuSecondsPerAudioSecond", cpuSeconds / audioSeconds);
+        result->setProperty("wallSecondsPerAudioSecond", juce::Time::highResolutionTicksToSeconds(processEnd - processStart) / audioSeconds);
+        result->setProperty("worstBlockPercentOfBudget", 100.0 * static_cast<double>(worstBlockTicks) / static_cast<double>(blockBudgetTicks));
+
+        // releasing and destroying is timed too, a host closing a big session goes through it
+        auto destroyStart = juce::Time::getHighResolutionTicks();
+
+        for (auto& processor : processors)
+            processor->releaseResources();
+
+        processors.clear();
+        result->setProperty("destroyMsPerInstance", ticksToMs(juce::Time::getHighResolutionTicks() - destroyStart) / numInstances);
+
+        return result;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+    Options options;
+
+    if (args.containsOption("--instances"))
+    {
+        options.instanceCounts.clear();
+
+        for (auto& count : juce::StringArray::fromTokens(args.getValueForOption("--instances"), ",", ""))
+            if (count.getIntValue() > 0)
+                options.instanceCounts.add(count.getIntValue());
+    }
+
+    if (args.containsOption("--seconds"))  options.secondsOfAudio = juce::jmax(0.01, args.getValueForOption("--seconds").getDoubleValue());
+    if (args.containsOption("--channels")) options.numChannels = juce::jmax(1, args.getValueForOption("--channels").getIntValue());
+    if (args.containsOption("--block"))    options.blockSize = juce::jmax(16, args.getValueForOption("--block").getIntValue());
+    if (args.containsOption("--editors"))  options.numEditors = juce::jmax(0, args.getValueForOption("--editors").getIntValue());
+    if (args.containsOption("--label"))    options.label = args.getValueForOption("--label");
+    if (args.containsOption("--output"))   options.outputFile = args.getFileForOption("--output");
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("label", options.label);
+    report->setProperty("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty("channels", options.numChannels);
+    report->setProperty("blockSize", options.blockSize);
+    report->setProperty("secondsOfAudio", options.secondsOfAudio);
+
+    juce::Array<juce::var> runs;
+
+    for (auto numInstances : options.instanceCounts)
+    {
+        runs.add(runInstances(options, numInstances));
+        std::cerr << "finished " << numInstances << " instances" << std::endl;
+    }
+
+    report->setProperty("runs", runs);
+
+    auto json = juce::JSON::toString(juce::var(report));
+
+    if (options.outputFile != juce::File())
+        options.outputFile.replaceWithText(json);
+    else
+        std::cout << json << std::endl;
+
+    return 0;
+}
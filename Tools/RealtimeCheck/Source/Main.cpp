@@ -0,0 +1,244 @@
+/*
+  ==============================================================================
+    Headless real-time safety test: drives EQAudioProcessor::processBlock with
+    randomised automation of every parameter, program changes, varying block
+    sizes and stretches of silence, in float and double, on a stereo bus with
+    a sidechain and on a wide bus shared out over worker threads. Like a
+    host, it runs on an audio thread of its own and automates from there,
+    while the main thread runs the message loop. Built with
+    EQ_REALTIME_CHECKS=1, so any allocation or lock inside processBlock or
+    parameterChanged is caught; it prints where they happened and exits with
+    1 if there were any.
+    It also checks that tiled processing gives exactly the same output as
+    untiled, with a tile size that isn't a multiple of anything in the chain.
+
+    RealtimeCheck [--blocks=n] [--seed=n] [--workers=n]
+  ==============================================================================
+*/
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+#if !EQ_REALTIME_CHECKS
+ #error "RealtimeCheck needs EQ_REALTIME_CHECKS=1 in the project's preprocessor definitions"
+#endif
+
+namespace
+{
+    struct Options
+    {
+        int numBlocks{ 5000 };
+        juce::int64 seed{ 1 };
+        int numWorkerThreads{ 2 };
+    };
+
+    constexpr double sampleRate = 48000.0;
+
+    // host sized blocks, and blocks big enough for the worker pool to take a wide bus
+    // (FilterEngine::minParallelGroupSamples is for all the groups together)
+    constexpr int hostBlockSize = 512, largeBlockSize = 8192;
+
+    // a few parameters at a time to anything in their range, the way a host throwing automation
+    // at it would, on the thread that calls processBlock. JUCE's own listener lock around the
+    // notification isn't ours to answer for, but parameterChanged is checked like processBlock.
+    void automate(EQAudioProcessor& processor, juce::Random& random)
+    {
+        auto& parameters = processor.getParameters();
+        auto numToMove = 1 + random.nextInt(4);
+
+        for (int i = 0; i < numToMove; ++i)
+            parameters[random.nextInt(parameters.size())]->setValueNotifyingHost(random.nextFloat());
+    }
+
+    // anything a processor posted to the message thread has been handled once this returns, so
+    // it can be deleted. Its designer is released by then, so nothing more gets posted.
+    void waitForMessageThread()
+    {
+        juce::WaitableEvent delivered;
+        juce::MessageManager::callAsync([&delivered] { delivered.signal(); });
+        delivered.wait();
+    }
+
+    template <typename SampleType>
+    bool run(const Options& options, int numChannels, bool useSidechain, int maxBlockSize, juce::Random& random)
+    {
+        EQAudioProcessor processor;
+        processor.setNumWorkerThreads(options.numWorkerThreads);
+
+        auto layout = processor.getBusesLayout();
+        layout.inputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(numChannels);
+        layout.outputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(numChannels);
+
+        if (useSidechain)
+            layout.inputBuses.getReference(1) = juce::AudioChannelSet::stereo();
+
+        processor.setBusesLayout(layout);
+
+        processor.setProcessingPrecision(std::is_same<SampleType, double>::value ? juce::AudioProcessor::doublePrecision
+                                                                                : juce::AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails(sampleRate, maxBlockSize);
+        processor.prepareToPlay(sampleRate, maxBlockSize);
+
+        auto numBufferChannels = juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+        juce::AudioBuffer<SampleType> buffer(numBufferChannels, maxBlockSize);
+        juce::MidiBuffer midi;
+
+        RealtimeChecks::resetCounts();
+
+        for (int block = 0; block < options.numBlocks; ++block)
+        {
+            automate(processor, random);
+
+            if (random.nextInt(250) == 0)
+                processor.setCurrentProgram(random.nextInt(processor.getNumPrograms()));
+
+            // every fifth stretch of 100 blocks is silent, so the processor goes to sleep and wakes up again
+            auto numSamples = 1 + random.nextInt(maxBlockSize);
+            auto silent = (block / 100) % 5 == 4;
+
+            for (int ch = 0; ch < numBufferChannels; ++ch)
+                for (int i = 0; i < numSamples; ++i)
+                    buffer.setSample(ch, i, silent ? SampleType() : static_cast<SampleType>(random.nextFloat() * 0.5f - 0.25f));
+
+            juce::AudioBuffer<SampleType> view(buffer.getArrayOfWritePointers(), numBufferChannels, numSamples);
+            processor.processBlock(view, midi);
+        }
+
+        processor.releaseResources();
+        waitForMessageThread();
+
+        auto summary = RealtimeChecks::getSummary();
+
+        std::cout << (std::is_same<SampleType, double>::value ? "double" : "float") << ", "
+                  << numChannels << " channels" << (useSidechain ? " + sidechain" : "") << ", blocks up to " << maxBlockSize << ": "
+                  << summary.numBlocks << " blocks, " << summary.numViolations << " violations in "
+                  << summary.blocksWithViolations << " blocks (at most " << summary.worstBlockViolations << " in one)" << std::endl;
+
+        if (summary.numViolations == 0)
+            return true;
+
+        std::cout << RealtimeChecks::describeViolations() << std::endl;
+        return false;
+    }
+
+    // two processors with the same settings, one working through every block in tiles of an odd
+    // size and one in a single pass, fed the same uneven blocks. Nothing is automated, so both
+    // keep the coefficient set prepareToPlay designed and the outputs have to match to the bit.
+    template <typename SampleType>
+    bool checkTiling(int numChannels, juce::Random& random)
+    {
+        constexpr int blockSize = 4096, oddTileSize = 100, numBlocks = 200;
+
+        EQAudioProcessor tiled, untiled;
+        tiled.setTileSize(oddTileSize);
+        untiled.setTileSize(blockSize * IirPath<SampleType>::maxOversamplingFactor);
+
+        auto numBufferChannels = 0;
+
+        for (auto* processor : { &tiled, &untiled })
+        {
+            auto layout = processor->getBusesLayout();
+            layout.inputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(numChannels);
+            layout.outputBuses.getReference(0) = juce::AudioChannelSet::discreteChannels(numChannels);
+            processor->setBusesLayout(layout);
+
+            // every stage running, with the dynamic peak's control intervals falling across the tiles
+            auto set = [processor](const juce::String& id, float value)
+            {
+                auto* parameter = processor->apvts.getParameter(id);
+                parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+            };
+
+            set("lowcutFreq", 80.f);
+            set("highcutFreq", 12000.f);
+            set("lowcutSlope", 3.f);
+            set("peakGain", 9.f);
+            set("dynamicPeak", 1.f);
+            set("dynamicThreshold", -30.f);
+            set(ChainParameters::getBandParameterID(0, "Type"), static_cast<float>(BandLowShelf));
+            set(ChainParameters::getBandParameterID(0, "Gain"), -4.f);
+
+            processor->setProcessingPrecision(std::is_same<SampleType, double>::value ? juce::AudioProcessor::doublePrecision
+                                                                                      : juce::AudioProcessor::singlePrecision);
+            processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+            processor->prepareToPlay(sampleRate, blockSize);
+
+            numBufferChannels = juce::jmax(processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels());
+        }
+
+        juce::AudioBuffer<SampleType> a(numBufferChannels, blockSize), b(numBufferChannels, blockSize);
+        juce::MidiBuffer midi;
+        auto matches = true;
+
+        for (int block = 0; block < numBlocks && matches; ++block)
+        {
+            auto numSamples = 1 + random.nextInt(blockSize);
+
+            for (int ch = 0; ch < numBufferChannels; ++ch)
+                for (int i = 0; i < numSamples; ++i)
+                    a.setSample(ch, i, static_cast<SampleType>(random.nextFloat() * 0.5f - 0.25f));
+
+            b.makeCopyOf(a, true);
+
+            juce::AudioBuffer<SampleType> viewA(a.getArrayOfWritePointers(), numBufferChannels, numSamples);
+            juce::AudioBuffer<SampleType> viewB(b.getArrayOfWritePointers(), numBufferChannels, numSamples);
+            tiled.processBlock(viewA, midi);
+            untiled.processBlock(viewB, midi);
+
+            for (int ch = 0; ch < numChannels && matches; ++ch)
+                matches = std::equal(viewA.getReadPointer(ch), viewA.getReadPointer(ch) + numSamples, viewB.getReadPointer(ch));
+        }
+
+        tiled.releaseResources();
+        untiled.releaseResources();
+        waitForMessageThread();
+
+        std::cout << (std::is_same<SampleType, double>::value ? "double" : "float") << ", " << numChannels << " channels, tiles of "
+                  << oddTileSize << ": " << (matches ? "same as untiled" : "DIFFERENT from untiled") << std::endl;
+
+        return matches;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+    Options options;
+
+    if (args.containsOption("--blocks"))  options.numBlocks = juce::jmax(1, args.getValueForOption("--blocks").getIntValue());
+    if (args.containsOption("--seed"))    options.seed = args.getValueForOption("--seed").getLargeIntValue();
+    if (args.containsOption("--workers")) options.numWorkerThreads = juce::jmax(0, args.getValueForOption("--workers").getIntValue());
+
+    std::atomic<bool> passed{ true };
+
+    // the processing runs on its own thread, so the message thread is free to do what it does
+    // in a host: set up the linear phase engine and report latency changes
+    juce::Thread::launch([&options, &passed]
+    {
+        juce::Random random(options.seed);
+        auto ok = true;
+
+        // the wide bus is more than one SIMD register at either precision. It only goes to the
+        // worker pool once the block is long enough, hence the runs with large blocks.
+        ok = run<float>(options, 2, true, hostBlockSize, random) && ok;
+        ok = run<double>(options, 2, true, hostBlockSize, random) && ok;
+        ok = run<float>(options, 16, false, hostBlockSize, random) && ok;
+        ok = run<double>(options, 16, false, hostBlockSize, random) && ok;
+        ok = run<float>(options, 16, false, largeBlockSize, random) && ok;
+        ok = run<double>(options, 16, false, largeBlockSize, random) && ok;
+
+        ok = checkTiling<float>(2, random) && ok;
+        ok = checkTiling<double>(2, random) && ok;
+        ok = checkTiling<float>(16, random) && ok;
+
+        passed = ok;
+        juce::MessageManager::getInstance()->stopDispatchLoop();
+    });
+
+    juce::MessageManager::getInstance()->runDispatchLoop();
+
+    std::cout << (passed ? "passed" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}